@@ -0,0 +1,230 @@
+#include "AabbTree.h"
+
+static float surfaceArea(vec3 minimum, vec3 maximum)
+{
+	vec3 d = maximum - minimum;
+	return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+AabbTree::AabbTree(float margin)
+	: root(-1), freeList(-1), leafCount(0), margin(margin)
+{
+}
+
+int AabbTree::allocateNode()
+{
+	int index;
+	if (freeList >= 0) {
+		index = freeList;
+		freeList = nodes[index].parent;
+	} else {
+		index = int(nodes.size());
+		nodes.push_back(Node());
+	}
+
+	Node& node = nodes[index];
+	node.parent = node.child1 = node.child2 = -1;
+	node.height = 0;
+	node.userData = 0;
+	return index;
+}
+
+void AabbTree::freeNode(int index)
+{
+	nodes[index].parent = freeList;
+	nodes[index].height = -1;
+	freeList = index;
+}
+
+int AabbTree::insert(vec3 minimum, vec3 maximum, uint32_t userData)
+{
+	int leaf = allocateNode();
+	nodes[leaf].minimum = minimum - vec3(margin);
+	nodes[leaf].maximum = maximum + vec3(margin);
+	nodes[leaf].userData = userData;
+	insertLeaf(leaf);
+	leafCount++;
+	return leaf;
+}
+
+void AabbTree::remove(int proxy)
+{
+	removeLeaf(proxy);
+	freeNode(proxy);
+	leafCount--;
+}
+
+bool AabbTree::move(int proxy, vec3 minimum, vec3 maximum)
+{
+	Node& leaf = nodes[proxy];
+	if (all(greaterThanEqual(minimum, leaf.minimum)) && all(lessThanEqual(maximum, leaf.maximum))) return false;
+
+	removeLeaf(proxy);
+	nodes[proxy].minimum = minimum - vec3(margin);
+	nodes[proxy].maximum = maximum + vec3(margin);
+	insertLeaf(proxy);
+	return true;
+}
+
+void AabbTree::insertLeaf(int leaf)
+{
+	if (root < 0) {
+		root = leaf;
+		nodes[root].parent = -1;
+		return;
+	}
+
+	//walk down to the sibling that adds the least surface area: the new parent costs its own area,
+	//every node above it grows by the difference of its area with and without the leaf
+	vec3 leafMin = nodes[leaf].minimum, leafMax = nodes[leaf].maximum;
+	int index = root;
+	while (!nodes[index].isLeaf()) {
+		const Node& node = nodes[index];
+		float area = surfaceArea(node.minimum, node.maximum);
+		float combinedArea = surfaceArea(glm::min(node.minimum, leafMin), glm::max(node.maximum, leafMax));
+		float cost = 2.0f * combinedArea;
+		float inheritanceCost = 2.0f * (combinedArea - area);
+
+		float childCost[2];
+		int children[2] = { node.child1, node.child2 };
+		for (int i = 0; i < 2; i++) {
+			const Node& child = nodes[children[i]];
+			float grown = surfaceArea(glm::min(child.minimum, leafMin), glm::max(child.maximum, leafMax));
+			childCost[i] = (child.isLeaf() ? grown : grown - surfaceArea(child.minimum, child.maximum)) + inheritanceCost;
+		}
+
+		if (cost < childCost[0] && cost < childCost[1]) break;
+		index = childCost[0] < childCost[1] ? children[0] : children[1];
+	}
+
+	int sibling = index;
+	int oldParent = nodes[sibling].parent;
+	int newParent = allocateNode();
+	nodes[newParent].parent = oldParent;
+	nodes[newParent].child1 = sibling;
+	nodes[newParent].child2 = leaf;
+	nodes[sibling].parent = newParent;
+	nodes[leaf].parent = newParent;
+
+	if (oldParent < 0) root = newParent;
+	else if (nodes[oldParent].child1 == sibling) nodes[oldParent].child1 = newParent;
+	else nodes[oldParent].child2 = newParent;
+
+	refit(newParent);
+}
+
+void AabbTree::removeLeaf(int leaf)
+{
+	if (leaf == root) {
+		root = -1;
+		return;
+	}
+
+	int parent = nodes[leaf].parent;
+	int grandParent = nodes[parent].parent;
+	int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+	//the sibling takes the parent's place
+	nodes[sibling].parent = grandParent;
+	freeNode(parent);
+	if (grandParent < 0) {
+		root = sibling;
+		return;
+	}
+
+	if (nodes[grandParent].child1 == parent) nodes[grandParent].child1 = sibling;
+	else nodes[grandParent].child2 = sibling;
+	refit(grandParent);
+}
+
+//recomputes boxes and heights from index up to the root, rebalancing on the way
+void AabbTree::refit(int index)
+{
+	while (index >= 0) {
+		index = balance(index);
+		Node& node = nodes[index];
+		const Node& child1 = nodes[node.child1];
+		const Node& child2 = nodes[node.child2];
+		node.height = 1 + std::max(child1.height, child2.height);
+		node.minimum = glm::min(child1.minimum, child2.minimum);
+		node.maximum = glm::max(child1.maximum, child2.maximum);
+		index = node.parent;
+	}
+}
+
+//if one child of a is more than one level higher than the other, its higher child is swapped with
+//the lower child of a, returns the node now in a's place
+int AabbTree::balance(int a)
+{
+	if (nodes[a].isLeaf() || nodes[a].height < 2) return a;
+
+	int b = nodes[a].child1, c = nodes[a].child2;
+	int difference = nodes[c].height - nodes[b].height;
+	if (difference >= -1 && difference <= 1) return a;
+
+	//rotate the higher child up, it keeps its higher child and hands the other one to a
+	bool right = difference > 1;
+	int up = right ? c : b, other = right ? b : c;
+	int f = nodes[up].child1, g = nodes[up].child2;
+
+	nodes[up].child1 = a;
+	nodes[up].parent = nodes[a].parent;
+	nodes[a].parent = up;
+	if (nodes[up].parent < 0) root = up;
+	else if (nodes[nodes[up].parent].child1 == a) nodes[nodes[up].parent].child1 = up;
+	else nodes[nodes[up].parent].child2 = up;
+
+	int keep = nodes[f].height > nodes[g].height ? f : g;
+	int give = keep == f ? g : f;
+	nodes[up].child2 = keep;
+	if (right) nodes[a].child2 = give;
+	else nodes[a].child1 = give;
+	nodes[give].parent = a;
+
+	nodes[a].minimum = glm::min(nodes[other].minimum, nodes[give].minimum);
+	nodes[a].maximum = glm::max(nodes[other].maximum, nodes[give].maximum);
+	nodes[a].height = 1 + std::max(nodes[other].height, nodes[give].height);
+	nodes[up].minimum = glm::min(nodes[a].minimum, nodes[keep].minimum);
+	nodes[up].maximum = glm::max(nodes[a].maximum, nodes[keep].maximum);
+	nodes[up].height = 1 + std::max(nodes[a].height, nodes[keep].height);
+	return up;
+}
+
+void AabbTree::query(const Frustum& frustum, vector<uint32_t>& result)
+{
+	if (root < 0) return;
+
+	stack.clear();
+	stack.push_back(root);
+	while (!stack.empty()) {
+		int index = stack.back();
+		stack.pop_back();
+		const Node& node = nodes[index];
+
+		FrustumTest test = frustum.classify(node.minimum, node.maximum);
+		if (test == FRUSTUM_OUTSIDE) continue;
+		if (test == FRUSTUM_INSIDE || node.isLeaf()) {
+			addSubtree(index, result);
+			continue;
+		}
+		stack.push_back(node.child1);
+		stack.push_back(node.child2);
+	}
+}
+
+//every leaf below index, without testing, the stack above it is left as it was
+void AabbTree::addSubtree(int index, vector<uint32_t>& result)
+{
+	size_t base = stack.size();
+	stack.push_back(index);
+	while (stack.size() > base) {
+		const Node& node = nodes[stack.back()];
+		stack.pop_back();
+		if (node.isLeaf()) {
+			result.push_back(node.userData);
+		} else {
+			stack.push_back(node.child1);
+			stack.push_back(node.child2);
+		}
+	}
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include "Frustum.h"
+
+using namespace glm;
+using namespace std;
+
+//world space box of an object space box moved by transform
+inline void transformBounds(const mat4& transform, vec3& minimum, vec3& maximum)
+{
+	vec3 center = vec3(transform * vec4((minimum + maximum) * 0.5f, 1.0f));
+	vec3 extent = (maximum - minimum) * 0.5f;
+	vec3 worldExtent = abs(vec3(transform[0])) * extent.x + abs(vec3(transform[1])) * extent.y + abs(vec3(transform[2])) * extent.z;
+	minimum = center - worldExtent;
+	maximum = center + worldExtent;
+}
+
+
+//Dynamic bounding volume hierarchy of world space boxes (as in Box2D's b2DynamicTree). Leaves
+//are placed next to the sibling that grows the tree's surface area the least and rotations keep
+//it balanced, so inserting, moving and removing objects only touches one path to the root.
+//Leaves store their box enlarged by a margin and small moves stay inside of it. Frustum queries
+//skip subtrees outside of the view and take subtrees completely inside without testing them,
+//so they cost about as much as there are visible objects.
+class AabbTree
+{
+public:
+	AabbTree(float margin = 0.5f);
+
+	//returns the proxy of the new leaf, userData is handed back by queries
+	int insert(vec3 minimum, vec3 maximum, uint32_t userData);
+	void remove(int proxy);
+	//true if the leaf had to be reinserted because the box left its enlarged box
+	bool move(int proxy, vec3 minimum, vec3 maximum);
+
+	//appends the userData of every leaf whose box is not outside the frustum
+	void query(const Frustum& frustum, vector<uint32_t>& result);
+
+	uint32_t getUserData(int proxy) const { return nodes[proxy].userData; }
+	size_t getLeafCount() const { return leafCount; }
+	int getHeight() const { return root < 0 ? 0 : nodes[root].height; }
+
+private:
+	struct Node {
+		vec3 minimum, maximum;
+		int parent;				//next free node while in the free list
+		int child1, child2;		//-1 for leaves
+		int height;				//0 for leaves, -1 for free nodes
+		uint32_t userData;
+
+		bool isLeaf() const { return child1 < 0; }
+	};
+
+	vector<Node> nodes;
+	int root, freeList;
+	size_t leafCount;
+	float margin;
+	vector<int> stack;		//reused by query
+
+	int allocateNode();
+	void freeNode(int index);
+	void insertLeaf(int leaf);
+	void removeLeaf(int leaf);
+	int balance(int index);
+	void refit(int index);
+	void addSubtree(int index, vector<uint32_t>& result);
+};
@@ -0,0 +1,133 @@
+#include "AssetLoader.h"
+#include "TextureCache.h"
+
+AssetLoader::AssetLoader(unsigned int workerCount)
+	: stopping(false), pending(0)
+{
+	if (workerCount == 0) {
+		unsigned int cores = thread::hardware_concurrency();
+		workerCount = cores > 1 ? cores - 1 : 1;
+	}
+	for (unsigned int i = 0; i < workerCount; i++)
+		workers.push_back(thread(&AssetLoader::run, this));
+}
+
+AssetLoader::~AssetLoader()
+{
+	{
+		lock_guard<mutex> lock(jobMutex);
+		stopping = true;
+	}
+	jobAvailable.notify_all();
+	for (thread& worker : workers) worker.join();
+
+	//decoded images that never made it to the GPU
+	for (AssetUpload& upload : uploads)
+		freeImage(upload.image);
+}
+
+void AssetLoader::loadModel(Model& model, const string& path)
+{
+	Model* target = &model;
+	addJob([this, target, path]() {
+		shared_ptr<ModelData> data = make_shared<ModelData>();
+		if (!Model::readModel(path, *data)) return;
+
+		//textures are decoded by the other workers while the meshes go to the GL thread
+		//files already in the TextureCache are only looked up on upload
+		for (const string& texturePath : data->texturePaths) {
+			addJob([this, target, texturePath, data]() {
+				ImageData image;
+				image.path = texturePath;
+				if (!TextureCache::get().contains(data->directory + '/' + texturePath))
+					image = loadImage(texturePath, data->directory);
+				addUpload({ AssetUpload::TEXTURE, target, data, 0, image });
+			});
+		}
+		for (size_t i = 0; i < data->meshes.size(); i++)
+			addUpload({ AssetUpload::MESH, target, data, i, ImageData() });
+
+		//uploads are processed in order, so the model is complete once this one comes up
+		addUpload({ AssetUpload::MODEL_READY, target, nullptr, 0, ImageData() });
+	});
+}
+
+void AssetLoader::update(double budgetMs)
+{
+	auto start = chrono::steady_clock::now();
+
+	//always upload at least one item so loading makes progress on slow frames
+	do {
+		AssetUpload next;
+		{
+			lock_guard<mutex> lock(uploadMutex);
+			if (uploads.empty()) return;
+			next = move(uploads.front());
+			uploads.pop_front();
+		}
+		upload(next);
+		pending--;
+	} while (chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() < budgetMs);
+}
+
+void AssetLoader::finish()
+{
+	while (pending > 0) {
+		{
+			unique_lock<mutex> lock(uploadMutex);
+			uploadAvailable.wait_for(lock, chrono::milliseconds(1), [this]() { return !uploads.empty(); });
+		}
+		update(1000.0);
+	}
+}
+
+void AssetLoader::run()
+{
+	while (true) {
+		function<void()> job;
+		{
+			unique_lock<mutex> lock(jobMutex);
+			jobAvailable.wait(lock, [this]() { return stopping || !jobs.empty(); });
+			if (stopping) return;
+			job = move(jobs.front());
+			jobs.pop_front();
+		}
+		job();
+		pending--;
+	}
+}
+
+void AssetLoader::addJob(function<void()> job)
+{
+	pending++;
+	{
+		lock_guard<mutex> lock(jobMutex);
+		jobs.push_back(move(job));
+	}
+	jobAvailable.notify_one();
+}
+
+void AssetLoader::addUpload(AssetUpload upload)
+{
+	pending++;
+	{
+		lock_guard<mutex> lock(uploadMutex);
+		uploads.push_back(move(upload));
+	}
+	uploadAvailable.notify_one();
+}
+
+void AssetLoader::upload(AssetUpload& upload)
+{
+	switch (upload.type) {
+	case AssetUpload::MESH:
+		upload.model->addMesh(upload.data->meshes[upload.meshIndex]);
+		break;
+	case AssetUpload::TEXTURE:
+		upload.model->addTexture(upload.image.path, TextureCache::get().acquire(upload.data->directory + '/' + upload.image.path, &upload.image));
+		break;
+	case AssetUpload::MODEL_READY:
+		upload.model->setReady();
+		break;
+	}
+}
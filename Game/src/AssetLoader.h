@@ -0,0 +1,69 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <chrono>
+#include <memory>
+#include <GL/glew.h>
+#include "Model.h"
+
+using namespace std;
+
+//Work handed from a loader thread to the GL thread
+struct AssetUpload {
+	enum Type { MESH, TEXTURE, MODEL_READY };
+
+	Type type;
+	Model* model;
+	shared_ptr<ModelData> data;		//the parsed model, for MESH meshIndex selects the mesh
+	size_t meshIndex;
+	ImageData image;				//TEXTURE: decoded pixels
+};
+
+
+//Loads models on worker threads: Assimp parsing and image decoding run in parallel, the
+//GL objects are created on the main thread by update() within a per-frame time budget.
+//Models stay unready (not drawn) until their meshes are uploaded, textures that are still
+//decoding are replaced by a 1x1 white placeholder in the meantime.
+class AssetLoader
+{
+public:
+	//workerCount 0 uses one thread per core, minus the main thread
+	AssetLoader(unsigned int workerCount = 0);
+	~AssetLoader();
+
+	//queues a model file, model has to stay alive until it is ready
+	void loadModel(Model& model, const string& path);
+
+	//creates GL objects for finished work until budgetMs is used up, call once per frame on the GL thread
+	void update(double budgetMs);
+
+	//blocks until everything queued so far is uploaded
+	void finish();
+
+	bool isIdle() const { return pending == 0; }
+
+private:
+	vector<thread> workers;
+	deque<function<void()>> jobs;
+	mutex jobMutex;
+	condition_variable jobAvailable;
+	bool stopping;
+
+	deque<AssetUpload> uploads;
+	mutex uploadMutex;
+	condition_variable uploadAvailable;
+
+	atomic<int> pending;		//jobs and uploads not yet done
+
+	void run();
+	void addJob(function<void()> job);
+	void addUpload(AssetUpload upload);
+	void upload(AssetUpload& upload);
+};
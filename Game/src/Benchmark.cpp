@@ -0,0 +1,195 @@
+#include "Benchmark.h"
+
+//------------------------CameraPath------------------------------------
+bool CameraPath::load(const string& path)
+{
+	ifstream file(path);
+	if (!file.is_open()) return false;
+
+	frames.clear();
+	CameraPathFrame frame;
+	while (file >> frame.keys >> frame.mouseX >> frame.mouseY >> frame.deltaTime)
+		frames.push_back(frame);
+
+	return !frames.empty();
+}
+
+bool CameraPath::save(const string& path) const
+{
+	ofstream file(path);
+	if (!file.is_open()) {
+		cout << "ERROR: could not write camera path " << path << endl;
+		return false;
+	}
+
+	for (const CameraPathFrame& frame : frames)
+		file << frame.keys << " " << frame.mouseX << " " << frame.mouseY << " " << frame.deltaTime << "\n";
+	return true;
+}
+
+void CameraPath::record(unsigned int keys, float mouseX, float mouseY, float deltaTime)
+{
+	frames.push_back({ keys, mouseX, mouseY, deltaTime });
+}
+
+void CameraPath::apply(Camera& cam, size_t i) const
+{
+	if (frames.empty()) return;
+	const CameraPathFrame& frame = frames[i % frames.size()];
+
+	if (frame.keys & (1 << FORWARD))	cam.processKeyboard(FORWARD, frame.deltaTime);
+	if (frame.keys & (1 << BACKWARD))	cam.processKeyboard(BACKWARD, frame.deltaTime);
+	if (frame.keys & (1 << LEFT))		cam.processKeyboard(LEFT, frame.deltaTime);
+	if (frame.keys & (1 << RIGHT))		cam.processKeyboard(RIGHT, frame.deltaTime);
+	if (frame.mouseX != 0.0f || frame.mouseY != 0.0f)
+		cam.processMouseMovement(frame.mouseX, frame.mouseY);
+}
+
+CameraPath CameraPath::createDefault(size_t frameCount)
+{
+	CameraPath path;
+	const float stepTime = 0.001f;		//short key taps per frame, the camera moves at moveSpeed units per second
+	for (size_t i = 0; i < frameCount; i++) {
+		//walk forward and turn slowly, every few seconds look up and down a bit
+		unsigned int keys = (i / 240) % 2 == 0 ? (1 << FORWARD) : (1 << RIGHT);
+		float pitch = ((i / 120) % 2 == 0) ? 2.0f : -2.0f;
+		path.record(keys, 10.0f, pitch, stepTime);
+	}
+	return path;
+}
+
+
+//------------------------Benchmark------------------------------------
+Benchmark::Benchmark(BenchmarkSettings settings, int width, int height)
+	: settings(settings), frameIndex(0), fbo(0), colorBuffer(0), depthBuffer(0)
+{
+	if (!path.load(settings.cameraPath)) {
+		cout << "Benchmark: no camera path at " << settings.cameraPath << ", using default path" << endl;
+		path = CameraPath::createDefault(settings.frames);
+	}
+
+	glGenQueries(QUERY_COUNT, queries);
+
+	if (settings.offscreen) {
+		glGenRenderbuffers(1, &colorBuffer);
+		glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+		glRenderbufferStorageMultisample(GL_RENDERBUFFER, 4, GL_RGBA8, width, height);
+		glGenRenderbuffers(1, &depthBuffer);
+		glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+		glRenderbufferStorageMultisample(GL_RENDERBUFFER, 4, GL_DEPTH24_STENCIL8, width, height);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+		glGenFramebuffers(1, &fbo);
+		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			cout << "ERROR: benchmark framebuffer incomplete" << endl;
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+}
+
+Benchmark::~Benchmark()
+{
+	glDeleteQueries(QUERY_COUNT, queries);
+	if (fbo) glDeleteFramebuffers(1, &fbo);
+	if (colorBuffer) glDeleteRenderbuffers(1, &colorBuffer);
+	if (depthBuffer) glDeleteRenderbuffers(1, &depthBuffer);
+}
+
+void Benchmark::beginFrame()
+{
+	frameStart = chrono::steady_clock::now();
+
+	//read back the timer that was issued QUERY_COUNT frames ago, it's done by now
+	if (frameIndex >= QUERY_COUNT) readGpuTime(frameIndex - QUERY_COUNT, true);
+
+	if (fbo) glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glBeginQuery(GL_TIME_ELAPSED, queries[frameIndex % QUERY_COUNT]);
+}
+
+void Benchmark::endSubmit()
+{
+	glEndQuery(GL_TIME_ELAPSED);
+	cpuTimes.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - frameStart).count());
+}
+
+void Benchmark::endFrame()
+{
+	frameTimes.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - frameStart).count());
+	frameIndex++;
+}
+
+void Benchmark::readGpuTime(int frame, bool wait)
+{
+	GLuint query = queries[frame % QUERY_COUNT];
+	if (!wait) {
+		GLint available = 0;
+		glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) return;
+	}
+	GLuint64 elapsed = 0;
+	glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+	gpuTimes.push_back(elapsed / 1.0e6);
+}
+
+void Benchmark::writeResults()
+{
+	//collect the timers still in flight
+	for (int i = std::max(0, frameIndex - QUERY_COUNT); i < frameIndex; i++)
+		readGpuTime(i, true);
+
+	ofstream csv(settings.output + ".csv");
+	csv << "frame,cpu_ms,gpu_ms,frame_ms\n";
+	for (size_t i = 0; i < frameTimes.size(); i++) {
+		csv << i << "," << cpuTimes[i] << ",";
+		if (i < gpuTimes.size()) csv << gpuTimes[i];
+		csv << "," << frameTimes[i] << "\n";
+	}
+
+	auto summary = [](ostream& out, const char* name, const vector<double>& values, bool last) {
+		double sum = 0.0;
+		for (double v : values) sum += v;
+		out << "\t\"" << name << "\": { ";
+		out << "\"mean\": " << (values.empty() ? 0.0 : sum / values.size()) << ", ";
+		out << "\"p50\": " << percentile(values, 0.50) << ", ";
+		out << "\"p95\": " << percentile(values, 0.95) << ", ";
+		out << "\"p99\": " << percentile(values, 0.99) << ", ";
+		out << "\"max\": " << (values.empty() ? 0.0 : *std::max_element(values.begin(), values.end())) << " }";
+		out << (last ? "\n" : ",\n");
+	};
+
+	ofstream json(settings.output + ".json");
+	json << "{\n";
+	json << "\t\"frames\": " << frameTimes.size() << ",\n";
+	json << "\t\"offscreen\": " << (settings.offscreen ? "true" : "false") << ",\n";
+	const GLubyte* renderer = glGetString(GL_RENDERER);
+	json << "\t\"renderer\": \"" << escapeJson(renderer ? (const char*)renderer : "") << "\",\n";
+	summary(json, "cpu_ms", cpuTimes, false);
+	summary(json, "gpu_ms", gpuTimes, false);
+	summary(json, "frame_ms", frameTimes, true);
+	json << "}\n";
+
+	cout << "Benchmark: " << frameTimes.size() << " frames, frame p50 " << percentile(frameTimes, 0.5)
+		<< "ms p99 " << percentile(frameTimes, 0.99) << "ms, written to " << settings.output << ".csv/.json" << endl;
+}
+
+//driver strings may contain quotes, backslashes or control characters
+string Benchmark::escapeJson(const string& text)
+{
+	ostringstream out;
+	for (unsigned char c : text) {
+		if (c == '"' || c == '\\') out << '\\' << c;
+		else if (c < 0x20) out << "\\u" << hex << setw(4) << setfill('0') << int(c) << dec;
+		else out << c;
+	}
+	return out.str();
+}
+
+double Benchmark::percentile(vector<double> values, double p)
+{
+	if (values.empty()) return 0.0;
+	size_t n = size_t(p * (values.size() - 1) + 0.5);
+	nth_element(values.begin(), values.begin() + n, values.end());
+	return values[n];
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <iomanip>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "Camera.h"
+
+using namespace std;
+
+//Camera input of one frame, as it would come from keyboard and mouse
+struct CameraPathFrame {
+	unsigned int keys;		//bit per CameraMovement (1 << FORWARD, ...)
+	float mouseX, mouseY;	//offsets passed to Camera::processMouseMovement
+	float deltaTime;		//frame time used for Camera::processKeyboard
+};
+
+//Recorded camera flight, replayed through the regular Camera input functions
+class CameraPath
+{
+public:
+	vector<CameraPathFrame> frames;
+
+	bool load(const string& path);
+	bool save(const string& path) const;
+
+	//Appends one frame of input while recording
+	void record(unsigned int keys, float mouseX, float mouseY, float deltaTime);
+
+	//Feeds frame i (wrapping around) into the camera
+	void apply(Camera& cam, size_t i) const;
+
+	//Slow walk around the scene, used when no recorded path is available
+	static CameraPath createDefault(size_t frameCount);
+};
+
+struct BenchmarkSettings {
+	int frames = 1000;
+	bool offscreen = false;
+	string cameraPath = "assets/benchmark/camera.path";
+	string output = "benchmark";		//writes <output>.csv and <output>.json
+};
+
+//Per-frame CPU/GPU timing for the headless benchmark mode
+class Benchmark
+{
+public:
+	Benchmark(BenchmarkSettings settings, int width, int height);
+	~Benchmark();
+
+	//Call at the start of a frame, binds the offscreen target if enabled
+	void beginFrame();
+	//Call after all draw calls (cpu) and after swapping buffers (frame)
+	void endSubmit();
+	void endFrame();
+
+	bool isFinished() const { return frameIndex >= settings.frames; }
+	int getFrameIndex() const { return frameIndex; }
+	const CameraPath& getCameraPath() const { return path; }
+
+	//Writes per-frame times to CSV and percentiles to JSON
+	void writeResults();
+
+private:
+	static const int QUERY_COUNT = 4;	//frames in flight before a GPU timer is read back
+
+	BenchmarkSettings settings;
+	CameraPath path;
+	int frameIndex;
+
+	GLuint queries[QUERY_COUNT];
+	GLuint fbo, colorBuffer, depthBuffer;
+
+	chrono::steady_clock::time_point frameStart;
+	vector<double> cpuTimes, frameTimes, gpuTimes;
+
+	void readGpuTime(int frame, bool wait);
+	static double percentile(vector<double> values, double p);
+	static string escapeJson(const string& text);
+};
@@ -0,0 +1,127 @@
+#include "CookedModel.h"
+
+static_assert(sizeof(MeshVertex) == 8 * sizeof(float), "cooked vertices are stored as 8 tightly packed floats");
+static_assert(sizeof(MeshLod) == 3 * sizeof(uint32_t), "cooked lods are stored as first index, index count, error");
+
+string cookedModelPath(const string& sourcePath)
+{
+	return sourcePath + ".cooked";
+}
+
+bool readCookedModel(const string& path, uint64_t sourceHash, ModelData& data)
+{
+	shared_ptr<MappedFile> file = make_shared<MappedFile>(path);
+	if (!file->isOpen()) return false;
+
+	const unsigned char* cursor = file->getData();
+	const unsigned char* end = cursor + file->getSize();
+
+	//returns the next size bytes (advanced to 4 byte alignment) or nullptr if the file is too short
+	auto take = [&cursor, end](size_t size) -> const unsigned char* {
+		size_t aligned = (size + 3) & ~size_t(3);
+		if (size_t(end - cursor) < aligned) return nullptr;
+		const unsigned char* p = cursor;
+		cursor += aligned;
+		return p;
+	};
+
+	const CookedModelHeader* header = reinterpret_cast<const CookedModelHeader*>(take(sizeof(CookedModelHeader)));
+	if (!header || memcmp(header->magic, "MDL0", 4) != 0 || header->version != COOKED_MODEL_VERSION || header->sourceHash != sourceHash)
+		return false;
+
+	vector<string> strings;
+	for (uint32_t i = 0; i < header->stringCount; i++) {
+		const uint32_t* length = reinterpret_cast<const uint32_t*>(take(sizeof(uint32_t)));
+		const unsigned char* chars = length ? take(*length) : nullptr;
+		if (!chars) return false;
+		strings.push_back(string(reinterpret_cast<const char*>(chars), *length));
+	}
+
+	data.meshes.resize(header->meshCount);
+	for (MeshData& mesh : data.meshes) {
+		const CookedMeshHeader* meshHeader = reinterpret_cast<const CookedMeshHeader*>(take(sizeof(CookedMeshHeader)));
+		if (!meshHeader) return false;
+
+		for (uint32_t i = 0; i < meshHeader->textureCount; i++) {
+			const uint32_t* ref = reinterpret_cast<const uint32_t*>(take(2 * sizeof(uint32_t)));
+			if (!ref || ref[0] >= strings.size() || ref[1] >= strings.size()) return false;
+			MeshTexture texture;
+			texture.id = 0;
+			texture.path = strings[ref[0]];
+			texture.type = strings[ref[1]];
+			mesh.textures.push_back(texture);
+			if (find(data.texturePaths.begin(), data.texturePaths.end(), texture.path) == data.texturePaths.end())
+				data.texturePaths.push_back(texture.path);
+		}
+
+		const MeshLod* lods = reinterpret_cast<const MeshLod*>(take(meshHeader->lodCount * sizeof(MeshLod)));
+		if (meshHeader->lodCount && !lods) return false;
+		for (uint32_t i = 0; i < meshHeader->lodCount; i++) {
+			if (size_t(lods[i].firstIndex) + lods[i].indexCount > meshHeader->indexCount) return false;
+			mesh.lods.push_back(lods[i]);
+		}
+
+		mesh.mappedVertices = reinterpret_cast<const MeshVertex*>(take(meshHeader->vertexCount * sizeof(MeshVertex)));
+		if (meshHeader->indexSize != sizeof(GLushort) && meshHeader->indexSize != sizeof(GLuint)) return false;
+		mesh.mappedIndexType = meshHeader->indexSize == sizeof(GLushort) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+		mesh.mappedIndices = take(size_t(meshHeader->indexCount) * meshHeader->indexSize);
+		if ((meshHeader->vertexCount && !mesh.mappedVertices) || (meshHeader->indexCount && !mesh.mappedIndices)) return false;
+		mesh.mappedVertexCount = meshHeader->vertexCount;
+		mesh.mappedIndexCount = meshHeader->indexCount;
+	}
+
+	//the meshes point into the mapping, it stays open as long as the data is used
+	data.file = file;
+	return true;
+}
+
+bool writeCookedModel(const string& path, uint64_t sourceHash, const ModelData& data)
+{
+	ofstream out(path, ios::binary);
+	if (!out.is_open()) {
+		cout << "ERROR: could not write cooked model " << path << endl;
+		return false;
+	}
+
+	auto write = [&out](const void* bytes, size_t size) {
+		const char padding[4] = { 0, 0, 0, 0 };
+		out.write(static_cast<const char*>(bytes), size);
+		out.write(padding, ((size + 3) & ~size_t(3)) - size);
+	};
+
+	//texture paths and types go into one string table
+	vector<string> strings;
+	auto stringIndex = [&strings](const string& s) {
+		size_t i = find(strings.begin(), strings.end(), s) - strings.begin();
+		if (i == strings.size()) strings.push_back(s);
+		return uint32_t(i);
+	};
+	vector<vector<uint32_t>> refs;
+	for (const MeshData& mesh : data.meshes) {
+		refs.push_back(vector<uint32_t>());
+		for (const MeshTexture& texture : mesh.textures) {
+			refs.back().push_back(stringIndex(texture.path));
+			refs.back().push_back(stringIndex(texture.type));
+		}
+	}
+
+	CookedModelHeader header = { { 'M', 'D', 'L', '0' }, COOKED_MODEL_VERSION, sourceHash, uint32_t(data.meshes.size()), uint32_t(strings.size()) };
+	write(&header, sizeof(header));
+	for (const string& s : strings) {
+		uint32_t length = uint32_t(s.size());
+		write(&length, sizeof(length));
+		write(s.data(), s.size());
+	}
+
+	for (size_t i = 0; i < data.meshes.size(); i++) {
+		const MeshData& mesh = data.meshes[i];
+		CookedMeshHeader meshHeader = { uint32_t(mesh.getVertexCount()), uint32_t(mesh.getIndexCount()), uint32_t(mesh.getIndexSize()), uint32_t(mesh.textures.size()), uint32_t(mesh.lods.size()) };
+		write(&meshHeader, sizeof(meshHeader));
+		if (!refs[i].empty()) write(refs[i].data(), refs[i].size() * sizeof(uint32_t));
+		if (!mesh.lods.empty()) write(mesh.lods.data(), mesh.lods.size() * sizeof(MeshLod));
+		write(mesh.getVertices(), mesh.getVertexCount() * sizeof(MeshVertex));
+		write(mesh.getIndices(), mesh.getIndexCount() * mesh.getIndexSize());
+	}
+
+	return out.good();
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include "Model.h"
+#include "MappedFile.h"
+
+using namespace std;
+
+//Cooked model files store the meshes exactly as they are uploaded, so loading is a file
+//mapping and no per-vertex work. Layout (4 byte aligned, little endian):
+//	CookedModelHeader
+//	stringCount x { uint32 length, chars, padding }		texture paths and types
+//	meshCount x { CookedMeshHeader, textureCount x { uint32 path, uint32 type }, lodCount x MeshLod, vertices, indices }
+const uint32_t COOKED_MODEL_VERSION = 4;		//bumped whenever the import optimization changes what is stored
+
+struct CookedModelHeader {
+	char magic[4];			//"MDL0"
+	uint32_t version;
+	uint64_t sourceHash;	//hash of the source file the model was cooked from
+	uint32_t meshCount;
+	uint32_t stringCount;
+};
+
+struct CookedMeshHeader {
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t indexSize;		//2 or 4 bytes
+	uint32_t textureCount;
+	uint32_t lodCount;
+};
+
+
+//cooked file belonging to a model source file, stored next to it
+string cookedModelPath(const string& sourcePath);
+
+//maps a cooked model, fails if it is missing, damaged or was cooked from a different source
+bool readCookedModel(const string& path, uint64_t sourceHash, ModelData& data);
+
+bool writeCookedModel(const string& path, uint64_t sourceHash, const ModelData& data);
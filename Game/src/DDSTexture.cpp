@@ -0,0 +1,91 @@
+#include "DDSTexture.h"
+#include <cstring>
+#include <memory>
+#include <iostream>
+#include <algorithm>
+#include "Model.h"
+#include "MappedFile.h"
+#include "Hash.h"
+
+static_assert(sizeof(DDSHeader) == 124, "DDS header has to match the file layout");
+
+//the renderer works in linear color, so sRGB variants are uploaded as their UNORM formats
+static GLenum glFormatFromDXGI(uint32_t dxgiFormat)
+{
+	switch (dxgiFormat) {
+	case 71: case 72: return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;		//BC1
+	case 74: case 75: return GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;		//BC2
+	case 77: case 78: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;		//BC3
+	case 83: return GL_COMPRESSED_RG_RGTC2;							//BC5
+	case 98: case 99: return GL_COMPRESSED_RGBA_BPTC_UNORM;			//BC7
+	default: return 0;
+	}
+}
+
+static GLenum glFormatFromFourCC(uint32_t code)
+{
+	if (code == fourCC('D', 'X', 'T', '1')) return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+	if (code == fourCC('D', 'X', 'T', '3')) return GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+	if (code == fourCC('D', 'X', 'T', '5')) return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	if (code == fourCC('A', 'T', 'I', '2') || code == fourCC('B', 'C', '5', 'U')) return GL_COMPRESSED_RG_RGTC2;
+	return 0;
+}
+
+size_t compressedLevelSize(GLenum format, int width, int height)
+{
+	size_t blockSize = format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT ? 8 : 16;
+	return size_t(std::max(1, (width + 3) / 4)) * size_t(std::max(1, (height + 3) / 4)) * blockSize;
+}
+
+bool readDDS(const string& path, ImageData& image)
+{
+	shared_ptr<MappedFile> file = make_shared<MappedFile>(path);
+	if (!file->isOpen() || file->getSize() < 4 + sizeof(DDSHeader)) return false;
+
+	const unsigned char* data = file->getData();
+	uint32_t magic;
+	DDSHeader header;
+	memcpy(&magic, data, sizeof(magic));
+	memcpy(&header, data + 4, sizeof(header));
+	if (magic != DDS_MAGIC || header.size != sizeof(DDSHeader) || !(header.pixelFormat.flags & DDPF_FOURCC)) {
+		cout << "DDS: " << path << " is not a block compressed DDS file" << endl;
+		return false;
+	}
+
+	size_t offset = 4 + sizeof(DDSHeader);
+	GLenum format;
+	if (header.pixelFormat.fourCC == fourCC('D', 'X', '1', '0')) {
+		DDSHeaderDX10 header10;
+		if (file->getSize() < offset + sizeof(header10)) return false;
+		memcpy(&header10, data + offset, sizeof(header10));
+		offset += sizeof(header10);
+		format = glFormatFromDXGI(header10.dxgiFormat);
+	} else {
+		format = glFormatFromFourCC(header.pixelFormat.fourCC);
+	}
+	if (!format) {
+		cout << "DDS: unsupported format in " << path << endl;
+		return false;
+	}
+
+	int levelCount = (header.flags & DDSD_MIPMAPCOUNT) && header.mipMapCount > 0 ? int(header.mipMapCount) : 1;
+	int width = int(header.width), height = int(header.height);
+	for (int i = 0; i < levelCount; i++) {
+		size_t size = compressedLevelSize(format, width, height);
+		if (file->getSize() < offset + size) {
+			cout << "DDS: " << path << " is truncated" << endl;
+			return false;
+		}
+		image.levels.push_back({ width, height, data + offset, size });
+		offset += size;
+		width = std::max(1, width / 2);
+		height = std::max(1, height / 2);
+	}
+
+	image.width = int(header.width);
+	image.height = int(header.height);
+	image.compressedFormat = format;
+	image.contentHash = hashBytes(data, offset);
+	image.file = file;
+	return true;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <GL/glew.h>
+
+using namespace std;
+
+//Block compressed textures in DDS files (legacy DXT1/DXT3/DXT5/ATI2 FourCCs or a DX10 header
+//with BC1/BC2/BC3/BC5/BC7). All mip levels are taken from the file, nothing is generated at load.
+//Rows are expected bottom-up like the flipped stb loads, TextureConverter writes them that way.
+//The file layout part of this header is shared with the TextureConverter tool.
+
+inline uint32_t fourCC(char a, char b, char c, char d)
+{
+	return uint32_t(uint8_t(a)) | (uint32_t(uint8_t(b)) << 8) | (uint32_t(uint8_t(c)) << 16) | (uint32_t(uint8_t(d)) << 24);
+}
+
+struct DDSPixelFormat {
+	uint32_t size;
+	uint32_t flags;
+	uint32_t fourCC;
+	uint32_t rgbBitCount;
+	uint32_t rBitMask, gBitMask, bBitMask, aBitMask;
+};
+
+struct DDSHeader {
+	uint32_t size;
+	uint32_t flags;
+	uint32_t height;
+	uint32_t width;
+	uint32_t pitchOrLinearSize;
+	uint32_t depth;
+	uint32_t mipMapCount;
+	uint32_t reserved1[11];
+	DDSPixelFormat pixelFormat;
+	uint32_t caps, caps2, caps3, caps4;
+	uint32_t reserved2;
+};
+
+struct DDSHeaderDX10 {
+	uint32_t dxgiFormat;
+	uint32_t resourceDimension;
+	uint32_t miscFlag;
+	uint32_t arraySize;
+	uint32_t miscFlags2;
+};
+
+const uint32_t DDS_MAGIC = 0x20534444;		//"DDS "
+const uint32_t DDSD_CAPS = 0x1, DDSD_HEIGHT = 0x2, DDSD_WIDTH = 0x4, DDSD_PIXELFORMAT = 0x1000, DDSD_MIPMAPCOUNT = 0x20000, DDSD_LINEARSIZE = 0x80000;
+const uint32_t DDPF_FOURCC = 0x4;
+const uint32_t DDSCAPS_COMPLEX = 0x8, DDSCAPS_TEXTURE = 0x1000, DDSCAPS_MIPMAP = 0x400000;
+
+struct ImageData;
+
+
+//maps a DDS file and fills image.levels with pointers into it, no GL calls
+bool readDDS(const string& path, ImageData& image);
+
+//bytes of one mip level of a block compressed format
+size_t compressedLevelSize(GLenum format, int width, int height);
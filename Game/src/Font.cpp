@@ -0,0 +1,192 @@
+#include "Font.h"
+
+const int ATLAS_WIDTH = 1024;
+const int ATLAS_INITIAL_HEIGHT = 512;
+const int GLYPH_PADDING = 1;		//empty texels between glyphs so linear filtering doesn't bleed
+
+Font::Font(const string& path, int pixelSize)
+	: library(nullptr), face(nullptr), pixelSize(pixelSize), atlasSize(ATLAS_WIDTH, ATLAS_INITIAL_HEIGHT)
+{
+	if (FT_Init_FreeType(&library)) std::cout << "ERROR::FREETYPE: Could not init FreeType Library" << std::endl;
+	else if (FT_New_Face(library, path.c_str(), 0, &face)) std::cout << "ERROR::FREETYPE: Failed to load font " << path << std::endl;
+	else FT_Set_Pixel_Sizes(face, 0, pixelSize * SDF_SUPERSAMPLE);		//width 0: derived from the height
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+	glTextureStorage2D(texture, 1, GL_R8, atlasSize.x, atlasSize.y);
+	glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	vector<unsigned char> clear(size_t(atlasSize.x) * atlasSize.y, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTextureSubImage2D(texture, 0, 0, 0, atlasSize.x, atlasSize.y, GL_RED, GL_UNSIGNED_BYTE, clear.data());
+
+	for (uint32_t c = 32; c < 127; c++)
+		getGlyph(c);
+}
+
+Font::~Font()
+{
+	glDeleteTextures(1, &texture);
+	if (face) FT_Done_Face(face);
+	if (library) FT_Done_FreeType(library);
+}
+
+const Glyph& Font::getGlyph(uint32_t codepoint)
+{
+	auto found = glyphs.find(codepoint);
+	if (found != glyphs.end()) return found->second;
+
+	Glyph glyph = { ivec2(0), ivec2(0), vec2(0.0f), 0.0f };
+	if (face && !FT_Load_Char(face, codepoint, FT_LOAD_RENDER)) {
+		FT_GlyphSlot slot = face->glyph;
+		const float s = float(SDF_SUPERSAMPLE);
+		glyph.advance = slot->advance.x / 64.0f / s;		//26.6 fixed point
+
+		if (slot->bitmap.width > 0 && slot->bitmap.rows > 0) {
+			ivec2 bitmapSize = (ivec2(slot->bitmap.width, slot->bitmap.rows) + SDF_SUPERSAMPLE - 1) / SDF_SUPERSAMPLE;
+			glyph.size = bitmapSize + 2 * SDF_SPREAD;
+			glyph.bearing = vec2(slot->bitmap_left / s - SDF_SPREAD, slot->bitmap_top / s + SDF_SPREAD);
+
+			vector<unsigned char> field = bakeDistanceField(slot, glyph.size);
+			while (!pack(glyph.size, glyph.position)) growAtlas();
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			glTextureSubImage2D(texture, 0, glyph.position.x, glyph.position.y, glyph.size.x, glyph.size.y, GL_RED, GL_UNSIGNED_BYTE, field.data());
+		}
+	}
+	return glyphs[codepoint] = glyph;
+}
+
+//squared euclidean distance transform of one row/column (Felzenszwalb & Huttenlocher),
+//f holds 0 on feature texels and INF elsewhere and is replaced by the squared distance
+static void distanceTransform1D(float* f, int n, int stride, vector<float>& d, vector<int>& v, vector<float>& z)
+{
+	const float INF = 1e20f;
+	int k = 0;
+	v[0] = 0;
+	z[0] = -INF;
+	z[1] = INF;
+	for (int q = 1; q < n; q++) {
+		float s = ((f[q * stride] + q * q) - (f[v[k] * stride] + v[k] * v[k])) / float(2 * q - 2 * v[k]);
+		while (s <= z[k]) {
+			k--;
+			s = ((f[q * stride] + q * q) - (f[v[k] * stride] + v[k] * v[k])) / float(2 * q - 2 * v[k]);
+		}
+		k++;
+		v[k] = q;
+		z[k] = s;
+		z[k + 1] = INF;
+	}
+
+	k = 0;
+	for (int q = 0; q < n; q++) {
+		while (z[k + 1] < q) k++;
+		int p = v[k];
+		d[q] = float(q - p) * float(q - p) + f[p * stride];
+	}
+	for (int q = 0; q < n; q++) f[q * stride] = d[q];
+}
+
+static void distanceTransform(vector<float>& grid, int width, int height)
+{
+	int n = std::max(width, height);
+	vector<float> d(n), z(n + 1);
+	vector<int> v(n);
+	for (int x = 0; x < width; x++) distanceTransform1D(&grid[x], height, width, d, v, z);
+	for (int y = 0; y < height; y++) distanceTransform1D(&grid[size_t(y) * width], width, 1, d, v, z);
+}
+
+vector<unsigned char> Font::bakeDistanceField(FT_GlyphSlot slot, ivec2 size) const
+{
+	//the high resolution grid covers the glyph texels including their border
+	const int s = SDF_SUPERSAMPLE;
+	const int border = SDF_SPREAD * s;
+	int width = size.x * s, height = size.y * s;
+	const float INF = 1e20f;
+
+	vector<float> toInside(size_t(width) * height, INF), toOutside(size_t(width) * height, 0.0f);
+	for (unsigned int y = 0; y < slot->bitmap.rows; y++)
+		for (unsigned int x = 0; x < slot->bitmap.width; x++)
+			if (slot->bitmap.buffer[y * slot->bitmap.pitch + x] >= 128) {
+				size_t i = size_t(y + border) * width + x + border;
+				toInside[i] = 0.0f;
+				toOutside[i] = INF;
+			}
+	distanceTransform(toInside, width, height);
+	distanceTransform(toOutside, width, height);
+
+	//average the signed distance over the high resolution texels of each atlas texel,
+	//the outline sits halfway between an inside and an outside texel
+	vector<unsigned char> field(size_t(size.x) * size.y);
+	for (int y = 0; y < size.y; y++)
+		for (int x = 0; x < size.x; x++) {
+			float sum = 0.0f;
+			for (int sy = 0; sy < s; sy++)
+				for (int sx = 0; sx < s; sx++) {
+					size_t i = size_t(y * s + sy) * width + x * s + sx;
+					sum += toInside[i] > 0.0f ? sqrt(toInside[i]) - 0.5f : 0.5f - sqrt(toOutside[i]);
+				}
+			float distance = sum / (s * s) / s;		//in atlas texels, positive outside
+			float value = glm::clamp(0.5f - distance / (2.0f * SDF_SPREAD), 0.0f, 1.0f);
+			field[size_t(y) * size.x + x] = (unsigned char)(value * 255.0f + 0.5f);
+		}
+	return field;
+}
+
+bool Font::pack(ivec2 size, ivec2& position)
+{
+	ivec2 padded = size + GLYPH_PADDING;
+
+	//the lowest shelf the glyph fits on wastes the least height
+	Shelf* best = nullptr;
+	for (Shelf& shelf : shelves)
+		if (padded.y <= shelf.height && shelf.x + padded.x <= atlasSize.x && (!best || shelf.height < best->height))
+			best = &shelf;
+
+	if (!best) {
+		int y = shelves.empty() ? 0 : shelves.back().y + shelves.back().height;
+		if (y + padded.y > atlasSize.y || padded.x > atlasSize.x) return false;
+		shelves.push_back({ y, padded.y, 0 });
+		best = &shelves.back();
+	}
+
+	position = ivec2(best->x, best->y);
+	best->x += padded.x;
+	return true;
+}
+
+void Font::growAtlas()
+{
+	//glyph positions are in texels, they stay valid; the shader divides by the current size
+	GLuint grown;
+	ivec2 size(atlasSize.x, atlasSize.y * 2);
+	glCreateTextures(GL_TEXTURE_2D, 1, &grown);
+	glTextureStorage2D(grown, 1, GL_R8, size.x, size.y);
+	glTextureParameteri(grown, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(grown, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(grown, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(grown, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	vector<unsigned char> clear(size_t(size.x) * (size.y - atlasSize.y), 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTextureSubImage2D(grown, 0, 0, atlasSize.y, size.x, size.y - atlasSize.y, GL_RED, GL_UNSIGNED_BYTE, clear.data());
+	glCopyImageSubData(texture, GL_TEXTURE_2D, 0, 0, 0, 0, grown, GL_TEXTURE_2D, 0, 0, 0, 0, atlasSize.x, atlasSize.y, 1);
+
+	glDeleteTextures(1, &texture);
+	texture = grown;
+	atlasSize = size;
+}
+
+uint32_t nextCodepoint(const string& text, size_t& i)
+{
+	unsigned char c = text[i++];
+	if (c < 0x80) return c;
+
+	int extra = c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : c >= 0xC0 ? 1 : -1;
+	if (extra < 0) return 0xFFFD;		//continuation byte without a lead byte
+	uint32_t codepoint = c & (0x3F >> extra);
+	for (int k = 0; k < extra; k++) {
+		if (i >= text.size() || (text[i] & 0xC0) != 0x80) return 0xFFFD;
+		codepoint = (codepoint << 6) | (text[i++] & 0x3F);
+	}
+	return codepoint;
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <iostream>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+using namespace glm;
+using namespace std;
+
+//One glyph in the atlas, all sizes in pixels of the font's pixel size
+struct Glyph {
+	ivec2 position;		//top left corner in the atlas
+	ivec2 size;			//includes the distance field border
+	vec2 bearing;		//offset from the pen position on the baseline to the top left of the glyph
+	float advance;		//horizontal pen advance
+};
+
+//distance field border around each glyph in atlas texels, also the distance that maps to 0 and 1
+const int SDF_SPREAD = 4;
+const int SDF_SUPERSAMPLE = 4;
+
+//FreeType font baked into a single signed distance field atlas. Every glyph is rasterized
+//at SDF_SUPERSAMPLE times the pixel size and stored as its distance to the outline, so one
+//atlas renders sharp at any scale. Printable ASCII is baked up front, any other code point
+//the first time it is used. Glyphs sit on shelves (rows as high as their tallest glyph);
+//a full atlas doubles its height.
+class Font
+{
+public:
+	Font(const string& path, int pixelSize);
+	~Font();
+
+	Font(const Font&) = delete;
+	Font& operator=(const Font&) = delete;
+
+	//packs the glyph on first use, code points missing from the font get an empty glyph
+	const Glyph& getGlyph(uint32_t codepoint);
+
+	GLuint getTexture() const { return texture; }
+	ivec2 getAtlasSize() const { return atlasSize; }
+	int getPixelSize() const { return pixelSize; }
+
+private:
+	struct Shelf {
+		int y, height;
+		int x;			//next free column
+	};
+
+	FT_Library library;
+	FT_Face face;
+	int pixelSize;
+
+	GLuint texture;
+	ivec2 atlasSize;
+	vector<Shelf> shelves;
+	unordered_map<uint32_t, Glyph> glyphs;
+
+	bool pack(ivec2 size, ivec2& position);
+	void growAtlas();
+	//turns the coverage bitmap of the glyph slot into distance field texels
+	vector<unsigned char> bakeDistanceField(FT_GlyphSlot slot, ivec2 size) const;
+};
+
+//decodes the next UTF-8 code point starting at i and advances i, invalid bytes decode as U+FFFD
+uint32_t nextCodepoint(const string& text, size_t& i);
@@ -0,0 +1,67 @@
+#pragma once
+#include <xmmintrin.h>
+#include <glm/glm.hpp>
+
+using namespace glm;
+
+enum FrustumTest { FRUSTUM_OUTSIDE, FRUSTUM_INTERSECTS, FRUSTUM_INSIDE };
+
+//View frustum as six planes (xyz normal pointing inside, w distance), taken from a view projection matrix
+struct Frustum {
+	vec4 planes[6];
+	//the planes transposed for testing four at a time, padded to eight with planes every box is inside of
+	float planeX[8], planeY[8], planeZ[8], planeW[8];
+
+	Frustum() {}
+
+	explicit Frustum(const mat4& viewProjection)
+	{
+		mat4 m = transpose(viewProjection);		//columns of m are the rows of the matrix
+		planes[0] = m[3] + m[0];	//left
+		planes[1] = m[3] - m[0];	//right
+		planes[2] = m[3] + m[1];	//bottom
+		planes[3] = m[3] - m[1];	//top
+		planes[4] = m[3] + m[2];	//near
+		planes[5] = m[3] - m[2];	//far
+		for (vec4& p : planes) p /= length(vec3(p));
+
+		for (int i = 0; i < 8; i++) {
+			vec4 p = i < 6 ? planes[i] : vec4(0.0f, 0.0f, 0.0f, 1.0f);
+			planeX[i] = p.x;
+			planeY[i] = p.y;
+			planeZ[i] = p.z;
+			planeW[i] = p.w;
+		}
+	}
+
+	//false only if the box is completely behind one of the planes
+	bool intersects(vec3 minimum, vec3 maximum) const
+	{
+		for (const vec4& p : planes) {
+			//corner of the box furthest along the plane normal
+			vec3 corner(p.x >= 0.0f ? maximum.x : minimum.x, p.y >= 0.0f ? maximum.y : minimum.y, p.z >= 0.0f ? maximum.z : minimum.z);
+			if (dot(vec3(p), corner) + p.w < 0.0f) return false;
+		}
+		return true;
+	}
+
+	//whether the box is outside, crosses or is completely inside, four planes per step:
+	//distance of the box center to each plane against the box extent projected on its normal
+	FrustumTest classify(vec3 minimum, vec3 maximum) const
+	{
+		const __m128 signMask = _mm_set1_ps(-0.0f);
+		vec3 c = (minimum + maximum) * 0.5f, e = (maximum - minimum) * 0.5f;
+		__m128 cx = _mm_set1_ps(c.x), cy = _mm_set1_ps(c.y), cz = _mm_set1_ps(c.z);
+		__m128 ex = _mm_set1_ps(e.x), ey = _mm_set1_ps(e.y), ez = _mm_set1_ps(e.z);
+
+		int crossing = 0;
+		for (int i = 0; i < 8; i += 4) {
+			__m128 px = _mm_loadu_ps(planeX + i), py = _mm_loadu_ps(planeY + i), pz = _mm_loadu_ps(planeZ + i);
+			__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, cx), _mm_mul_ps(py, cy)), _mm_add_ps(_mm_mul_ps(pz, cz), _mm_loadu_ps(planeW + i)));
+			__m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, px), ex), _mm_mul_ps(_mm_andnot_ps(signMask, py), ey)), _mm_mul_ps(_mm_andnot_ps(signMask, pz), ez));
+			if (_mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(d, r), _mm_setzero_ps()))) return FRUSTUM_OUTSIDE;
+			crossing |= _mm_movemask_ps(_mm_cmplt_ps(_mm_sub_ps(d, r), _mm_setzero_ps()));
+		}
+		return crossing ? FRUSTUM_INTERSECTS : FRUSTUM_INSIDE;
+	}
+};
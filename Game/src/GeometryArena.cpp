@@ -0,0 +1,116 @@
+#include "GeometryArena.h"
+
+//initial sizes, buffers double when full
+const size_t INITIAL_VERTICES = 1 << 18;
+const size_t INITIAL_INDICES = 1 << 20;
+const size_t INITIAL_DRAW_INDICES = 1 << 14;
+
+GeometryArena& GeometryArena::get()
+{
+	static GeometryArena arena;
+	return arena;
+}
+
+GeometryArena::GeometryArena()
+	: vertexCount(0), vertexCapacity(INITIAL_VERTICES), drawIndexCapacity(0)
+{
+	glCreateBuffers(1, &vertexBuffer);
+	glNamedBufferData(vertexBuffer, vertexCapacity * sizeof(MeshVertex), NULL, GL_STATIC_DRAW);
+	glCreateBuffers(1, &drawIndexBuffer);
+
+	createStore(shortIndices, sizeof(GLushort));
+	createStore(intIndices, sizeof(GLuint));
+	reserveDrawIndices(INITIAL_DRAW_INDICES);
+}
+
+void GeometryArena::createStore(IndexStore& store, size_t indexSize)
+{
+	store.indexSize = indexSize;
+	store.count = 0;
+	store.capacity = INITIAL_INDICES;
+	glCreateBuffers(1, &store.buffer);
+	glNamedBufferData(store.buffer, store.capacity * indexSize, NULL, GL_STATIC_DRAW);
+
+	GLuint vao;
+	glCreateVertexArrays(1, &vao);
+
+	// binding 0: per vertex data
+	glVertexArrayVertexBuffer(vao, 0, vertexBuffer, 0, sizeof(MeshVertex));
+	glEnableVertexArrayAttrib(vao, 0);
+	glVertexArrayAttribFormat(vao, 0, 3, GL_FLOAT, GL_FALSE, offsetof(MeshVertex, position));
+	glVertexArrayAttribBinding(vao, 0, 0);
+	glEnableVertexArrayAttrib(vao, 1);
+	glVertexArrayAttribFormat(vao, 1, 3, GL_FLOAT, GL_FALSE, offsetof(MeshVertex, normal));
+	glVertexArrayAttribBinding(vao, 1, 0);
+	glEnableVertexArrayAttrib(vao, 2);
+	glVertexArrayAttribFormat(vao, 2, 2, GL_FLOAT, GL_FALSE, offsetof(MeshVertex, textureCoords));
+	glVertexArrayAttribBinding(vao, 2, 0);
+
+	// binding 1: draw index, advanced once per instance and offset by baseInstance
+	glEnableVertexArrayAttrib(vao, 3);
+	glVertexArrayAttribIFormat(vao, 3, 1, GL_UNSIGNED_INT, 0);
+	glVertexArrayAttribBinding(vao, 3, 1);
+	glVertexArrayBindingDivisor(vao, 1, 1);
+
+	glVertexArrayElementBuffer(vao, store.buffer);
+	store.vao = vao;
+}
+
+ArenaRange GeometryArena::allocate(const MeshVertex* vertices, size_t count, const void* indices, GLenum indexType, size_t countIndices)
+{
+	IndexStore& store = indexType == GL_UNSIGNED_SHORT ? shortIndices : intIndices;
+
+	if (vertexCount + count > vertexCapacity) {
+		size_t capacity = vertexCapacity;
+		while (vertexCount + count > capacity) capacity *= 2;
+		grow(vertexBuffer, vertexCount * sizeof(MeshVertex), capacity * sizeof(MeshVertex));
+		glVertexArrayVertexBuffer(shortIndices.vao, 0, vertexBuffer, 0, sizeof(MeshVertex));
+		glVertexArrayVertexBuffer(intIndices.vao, 0, vertexBuffer, 0, sizeof(MeshVertex));
+		vertexCapacity = capacity;
+	}
+	if (store.count + countIndices > store.capacity) {
+		size_t capacity = store.capacity;
+		while (store.count + countIndices > capacity) capacity *= 2;
+		grow(store.buffer, store.count * store.indexSize, capacity * store.indexSize);
+		glVertexArrayElementBuffer(store.vao, store.buffer);
+		store.capacity = capacity;
+	}
+
+	glNamedBufferSubData(vertexBuffer, vertexCount * sizeof(MeshVertex), count * sizeof(MeshVertex), vertices);
+	glNamedBufferSubData(store.buffer, store.count * store.indexSize, countIndices * store.indexSize, indices);
+
+	ArenaRange range = { GLint(vertexCount), GLuint(store.count), GLuint(countIndices), indexType };
+	vertexCount += count;
+	store.count += countIndices;
+	return range;
+}
+
+void GeometryArena::reserveDrawIndices(size_t count)
+{
+	if (count <= drawIndexCapacity) return;
+
+	size_t capacity = drawIndexCapacity ? drawIndexCapacity : 1;
+	while (capacity < count) capacity *= 2;
+
+	vector<GLuint> drawIndices(capacity);
+	for (size_t i = 0; i < capacity; i++) drawIndices[i] = GLuint(i);
+	glNamedBufferData(drawIndexBuffer, capacity * sizeof(GLuint), drawIndices.data(), GL_STATIC_DRAW);
+	glVertexArrayVertexBuffer(shortIndices.vao, 1, drawIndexBuffer, 0, sizeof(GLuint));
+	glVertexArrayVertexBuffer(intIndices.vao, 1, drawIndexBuffer, 0, sizeof(GLuint));
+	drawIndexCapacity = capacity;
+}
+
+void GeometryArena::bind(GLenum indexType) const
+{
+	glBindVertexArray(getVao(indexType));
+}
+
+void GeometryArena::grow(GLuint& buffer, size_t usedSize, size_t newSize)
+{
+	GLuint newBuffer;
+	glCreateBuffers(1, &newBuffer);
+	glNamedBufferData(newBuffer, newSize, NULL, GL_STATIC_DRAW);
+	if (usedSize > 0) glCopyNamedBufferSubData(buffer, newBuffer, 0, 0, usedSize);
+	glDeleteBuffers(1, &buffer);
+	buffer = newBuffer;
+}
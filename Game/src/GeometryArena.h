@@ -0,0 +1,71 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "Mesh.h"
+
+using namespace std;
+
+//Location of a mesh inside the arena buffers
+struct ArenaRange {
+	GLint baseVertex;
+	GLuint firstIndex;		//in indices of indexType
+	GLuint indexCount;
+	GLenum indexType;		//GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+};
+
+//Layout of glMultiDrawElementsIndirect commands
+struct DrawElementsIndirectCommand {
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
+
+//All mesh vertices and indices packed into a few large buffers. 16 and 32 bit indices live in
+//separate buffers, each behind its own VAO sharing the vertex buffer.
+//Vertex attributes: 0 position, 1 normal, 2 texture coords, 3 draw index (one per instance,
+//equal to baseInstance + gl_InstanceID, used to look up per-draw data in the shader).
+class GeometryArena
+{
+public:
+	//the arena is created on first use, a GL context has to be current
+	static GeometryArena& get();
+
+	//indexType is GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+	ArenaRange allocate(const MeshVertex* vertices, size_t vertexCount, const void* indices, GLenum indexType, size_t indexCount);
+
+	//makes sure draw indices 0..count-1 can be addressed
+	void reserveDrawIndices(size_t count);
+
+	//binds the VAO drawing indices of the given type
+	void bind(GLenum indexType) const;
+	GLuint getVao(GLenum indexType) const { return indexType == GL_UNSIGNED_SHORT ? shortIndices.vao : intIndices.vao; }
+
+private:
+	//index buffer of one index type and the VAO it is attached to
+	struct IndexStore {
+		GLuint vao;
+		GLuint buffer;
+		size_t indexSize;
+		size_t count, capacity;
+	};
+
+	GLuint vertexBuffer, drawIndexBuffer;
+	size_t vertexCount, vertexCapacity;
+	size_t drawIndexCapacity;
+	IndexStore shortIndices, intIndices;
+
+	GeometryArena();
+	GeometryArena(const GeometryArena&) = delete;
+	GeometryArena& operator=(const GeometryArena&) = delete;
+
+	void createStore(IndexStore& store, size_t indexSize);
+
+	//reallocates a buffer to newSize bytes, keeping the first usedSize bytes
+	static void grow(GLuint& buffer, size_t usedSize, size_t newSize);
+};
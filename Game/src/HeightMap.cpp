@@ -1,32 +1,51 @@
-#include "Heightmap.h"
+#include "HeightMap.h"
 
-HeightMap::HeightMap(const char* heightMapPath)
+HeightMap::HeightMap(const char* heightMapPath, bool upload)
+	: heightMapID(0), width(0), height(0), nrChannels(0)
 {
-	glGenTextures(1, &heightMapID);
-	bind();
+	//y = 0 is the bottom row, like the texture; the flag is per thread, set it whatever was loaded here before
+	stbi_set_flip_vertically_on_load_thread(true);
 
-	//Wrapping and Filtering options
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	//load and generate texture
-	stbi_set_flip_vertically_on_load(true); //because y=0 at images are on top of axis
-	unsigned char* data = stbi_load(heightMapPath, &width, &height, &nrChannels, 0);
-	if (data) {
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
+	//one channel is enough, 16 bit images keep their precision
+	if (stbi_is_16_bit(heightMapPath)) {
+		stbi_us* data = stbi_load_16(heightMapPath, &width, &height, &nrChannels, 1);
+		if (data) {
+			heights.resize(size_t(width) * height);
+			for (size_t i = 0; i < heights.size(); i++) heights[i] = data[i] / 65535.0f;
+		}
+		stbi_image_free(data);
 	}
 	else {
-		std::cout << "Loading texture failed!" << std::endl;
+		unsigned char* data = stbi_load(heightMapPath, &width, &height, &nrChannels, 1);
+		if (data) {
+			heights.resize(size_t(width) * height);
+			for (size_t i = 0; i < heights.size(); i++) heights[i] = data[i] / 255.0f;
+		}
+		stbi_image_free(data);
+	}
+
+	if (heights.empty()) {
+		std::cout << "Loading height map failed: " << heightMapPath << std::endl;
+		width = height = 1;
+		heights.assign(1, 0.0f);
 	}
-	stbi_image_free(data);
+	if (!upload) return;
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &heightMapID);
+	glTextureStorage2D(heightMapID, 1, GL_R32F, width, height);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTextureSubImage2D(heightMapID, 0, 0, 0, width, height, GL_RED, GL_FLOAT, heights.data());
+
+	//Wrapping and Filtering options
+	glTextureParameteri(heightMapID, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(heightMapID, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(heightMapID, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(heightMapID, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 }
 
 HeightMap::~HeightMap()
 {
-	glDeleteTextures(GL_TEXTURE_2D, &heightMapID);
+	if (heightMapID) glDeleteTextures(1, &heightMapID);
 }
 
 void HeightMap::bind()
@@ -39,3 +58,39 @@ void HeightMap::unbind()
 	glBindTexture(GL_TEXTURE_2D, 0);
 }
 
+float HeightMap::getTexel(int x, int y) const
+{
+	x = glm::clamp(x, 0, width - 1);
+	y = glm::clamp(y, 0, height - 1);
+	return heights[size_t(y) * width + x];
+}
+
+float HeightMap::sample(vec2 uv) const
+{
+	//texel centers, the same filtering GL_LINEAR does with clamp to edge
+	vec2 p = uv * vec2(width, height) - 0.5f;
+	vec2 base = floor(p);
+	vec2 f = p - base;
+	int x = int(base.x), y = int(base.y);
+	float bottom = mix(getTexel(x, y), getTexel(x + 1, y), f.x);
+	float top = mix(getTexel(x, y + 1), getTexel(x + 1, y + 1), f.x);
+	return mix(bottom, top, f.y);
+}
+
+void HeightMap::getRange(int x0, int y0, int x1, int y1, float& minimum, float& maximum) const
+{
+	x0 = glm::clamp(x0, 0, width - 1);
+	x1 = glm::clamp(x1, 0, width - 1);
+	y0 = glm::clamp(y0, 0, height - 1);
+	y1 = glm::clamp(y1, 0, height - 1);
+
+	minimum = 1.0f;
+	maximum = 0.0f;
+	for (int y = y0; y <= y1; y++) {
+		const float* row = &heights[size_t(y) * width];
+		for (int x = x0; x <= x1; x++) {
+			minimum = std::min(minimum, row[x]);
+			maximum = std::max(maximum, row[x]);
+		}
+	}
+}
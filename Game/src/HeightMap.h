@@ -1,19 +1,46 @@
 #pragma once
 #include <iostream>
+#include <vector>
+#include <algorithm>
 #include "GL/glew.h"
 #include "GLFW/glfw3.h"
+#include <glm/glm.hpp>
 #include "stb_image.h"
 
+using namespace glm;
+using namespace std;
+
+//Height map kept on the CPU for terrain culling and physics, and uploaded as a float texture
+//for the terrain vertex shader. Heights are in [0, 1], row 0 is the bottom of the image.
 class HeightMap
 {
 public:
-	HeightMap(const char* heightMapPath);
+	//upload false keeps the map on the CPU only, e.g. to cut it into terrain tiles
+	HeightMap(const char* heightMapPath, bool upload = true);
 	~HeightMap();
 
+	HeightMap(const HeightMap&) = delete;
+	HeightMap& operator=(const HeightMap&) = delete;
 
 	void bind();
 	void unbind();
+	GLuint getId() const { return heightMapID; }
+
+	int getWidth() const { return width; }
+	int getHeight() const { return height; }
+	bool isLoaded() const { return !heights.empty(); }
+	//width x height floats, rows along +z, stays valid as long as the height map exists
+	const float* getData() const { return heights.data(); }
+
+	//height of one texel, coordinates are clamped to the map
+	float getTexel(int x, int y) const;
+	//bilinear height at uv in [0, 1]
+	float sample(vec2 uv) const;
+	//lowest and highest texel in the rectangle [x0, x1] x [y0, y1]
+	void getRange(int x0, int y0, int x1, int y1, float& minimum, float& maximum) const;
+
 private:
 	GLuint heightMapID;
 	int width, height, nrChannels;
+	vector<float> heights;
 };
@@ -0,0 +1,44 @@
+#pragma once
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+using namespace glm;
+
+//Uniform block binding points, must match the layout(binding = N) in the shaders
+const GLuint CAMERA_BLOCK_BINDING = 0;
+const GLuint LIGHT_BLOCK_BINDING = 1;
+
+const int NR_DIR_LIGHTS = 3;
+
+//The structs below mirror the std140 uniform blocks in the shaders:
+//vec3s start on 16 byte boundaries, a following float fills the gap.
+//PointLight has the same layout in the std430 point light buffer (see LightClusters.h).
+
+struct DirLight {
+	vec3 direction;		float pad0;
+	vec3 ambient;		float pad1;
+	vec3 diffuse;		float pad2;
+	vec3 specular;		float pad3;
+};
+
+struct PointLight {
+	vec3 position;		float constant;
+	vec3 ambient;		float linear;
+	vec3 diffuse;		float quadratic;
+	vec3 specular;		float pad0;
+};
+
+//layout(std140, binding = 0) uniform Camera
+struct CameraBlock {
+	mat4 viewMatrix;
+	mat4 projectionMatrix;
+	vec3 viewPos;		float pad0;
+};
+
+//layout(std140, binding = 1) uniform Lights
+struct LightBlock {
+	DirLight dirLights[NR_DIR_LIGHTS];
+};
+
+static_assert(sizeof(DirLight) == 64 && sizeof(PointLight) == 64, "light structs must match the std140 layout");
+static_assert(sizeof(CameraBlock) == 144, "camera block must match the std140 layout");
@@ -0,0 +1,128 @@
+#include "LightClusters.h"
+
+LightClusters::LightClusters()
+	: boundsProjection(0.0f)
+{
+	glCreateBuffers(1, &lightBuffer);
+	glCreateBuffers(1, &clusterBuffer);
+}
+
+LightClusters::~LightClusters()
+{
+	glDeleteBuffers(1, &lightBuffer);
+	glDeleteBuffers(1, &clusterBuffer);
+}
+
+float LightClusters::lightRadius(const PointLight& light, float maxRadius)
+{
+	//solve intensity / (constant + linear * d + quadratic * d^2) = LIGHT_CUTOFF for d
+	vec3 brightest = glm::max(glm::max(light.ambient, light.diffuse), light.specular);
+	float intensity = std::max(brightest.x, std::max(brightest.y, brightest.z));
+	float c = light.constant - intensity / LIGHT_CUTOFF;
+	if (c >= 0.0f) return 0.0f;		//never bright enough to matter
+	float radius;
+	if (light.quadratic > 0.0f) radius = (-light.linear + sqrt(light.linear * light.linear - 4.0f * light.quadratic * c)) / (2.0f * light.quadratic);
+	else if (light.linear > 0.0f) radius = -c / light.linear;
+	else radius = maxRadius;
+	return std::min(radius, maxRadius);
+}
+
+float LightClusters::sliceDepth(int slice, float zNear, float zFar) const
+{
+	return zNear * pow(zFar / zNear, float(slice) / CLUSTER_Z);
+}
+
+void LightClusters::buildBounds(float fovy, float aspect, float zNear, float zFar)
+{
+	boundsProjection = vec4(fovy, aspect, zNear, zFar);
+	bounds.resize(CLUSTER_COUNT);
+
+	//the camera looks down -z, tiles are numbered from the bottom left like gl_FragCoord
+	float tanY = tan(fovy * 0.5f), tanX = tanY * aspect;
+	for (int z = 0; z < CLUSTER_Z; z++) {
+		float near = sliceDepth(z, zNear, zFar), far = sliceDepth(z + 1, zNear, zFar);
+		for (int y = 0; y < CLUSTER_Y; y++) {
+			float y0 = (-1.0f + 2.0f * y / CLUSTER_Y) * tanY, y1 = (-1.0f + 2.0f * (y + 1) / CLUSTER_Y) * tanY;
+			for (int x = 0; x < CLUSTER_X; x++) {
+				float x0 = (-1.0f + 2.0f * x / CLUSTER_X) * tanX, x1 = (-1.0f + 2.0f * (x + 1) / CLUSTER_X) * tanX;
+				ClusterBounds& b = bounds[x + CLUSTER_X * (y + CLUSTER_Y * z)];
+				b.min = vec3(std::min(x0 * near, x0 * far), std::min(y0 * near, y0 * far), -far);
+				b.max = vec3(std::max(x1 * near, x1 * far), std::max(y1 * near, y1 * far), -near);
+			}
+		}
+	}
+}
+
+void LightClusters::update(const vector<PointLight>& lights, const mat4& view, float fovy, float aspect, float zNear, float zFar, ivec2 viewport)
+{
+	if (boundsProjection != vec4(fovy, aspect, zNear, zFar)) buildBounds(fovy, aspect, zNear, zFar);
+
+	float tanY = tan(fovy * 0.5f), tanX = tanY * aspect;
+	float logRatio = log(zFar / zNear);
+
+	assignments.clear();
+	for (GLuint i = 0; i < lights.size(); i++) {
+		float radius = lightRadius(lights[i], zFar);
+		if (radius <= 0.0f) continue;
+		vec3 center = vec3(view * vec4(lights[i].position, 1.0f));
+		float near = -center.z - radius, far = -center.z + radius;
+		if (far < zNear || near > zFar) continue;
+
+		//slices the sphere's depth range touches
+		int z0 = std::max(0, int(floor(log(std::max(near, zNear) / zNear) / logRatio * CLUSTER_Z)));
+		int z1 = std::min(CLUSTER_Z - 1, int(floor(log(std::min(far, zFar) / zNear) / logRatio * CLUSTER_Z)));
+
+		for (int z = z0; z <= z1; z++) {
+			//tiles the sphere's view space box can reach between the slice's near and far depth
+			float dn = sliceDepth(z, zNear, zFar), df = sliceDepth(z + 1, zNear, zFar);
+			float minX = std::min((center.x - radius) / dn, (center.x - radius) / df) / tanX;
+			float maxX = std::max((center.x + radius) / dn, (center.x + radius) / df) / tanX;
+			float minY = std::min((center.y - radius) / dn, (center.y - radius) / df) / tanY;
+			float maxY = std::max((center.y + radius) / dn, (center.y + radius) / df) / tanY;
+			int x0 = std::max(0, int(floor((minX + 1.0f) * 0.5f * CLUSTER_X)));
+			int x1 = std::min(CLUSTER_X - 1, int(floor((maxX + 1.0f) * 0.5f * CLUSTER_X)));
+			int y0 = std::max(0, int(floor((minY + 1.0f) * 0.5f * CLUSTER_Y)));
+			int y1 = std::min(CLUSTER_Y - 1, int(floor((maxY + 1.0f) * 0.5f * CLUSTER_Y)));
+
+			for (int y = y0; y <= y1; y++)
+				for (int x = x0; x <= x1; x++) {
+					GLuint cluster = x + CLUSTER_X * (y + CLUSTER_Y * z);
+					const ClusterBounds& b = bounds[cluster];
+					vec3 closest = glm::clamp(center, b.min, b.max);
+					vec3 d = closest - center;
+					if (dot(d, d) <= radius * radius) assignments.push_back(uvec2(cluster, i));
+				}
+		}
+	}
+
+	//counting sort by cluster: (offset, count) per cluster, then the light indices
+	grid.assign(2 * CLUSTER_COUNT + assignments.size(), 0);
+	for (const uvec2& a : assignments) grid[2 * a.x + 1]++;
+	GLuint offset = 2 * CLUSTER_COUNT;
+	for (int c = 0; c < CLUSTER_COUNT; c++) {
+		grid[2 * c] = offset;
+		offset += grid[2 * c + 1];
+	}
+	for (int c = 0; c < CLUSTER_COUNT; c++) grid[2 * c + 1] = 0;
+	for (const uvec2& a : assignments) {
+		GLuint& count = grid[2 * a.x + 1];
+		grid[grid[2 * a.x] + count++] = a.y;
+	}
+
+	LightClusterHeader header;
+	header.tileScale = vec2(float(CLUSTER_X) / viewport.x, float(CLUSTER_Y) / viewport.y);
+	header.sliceScale = CLUSTER_Z / logRatio;
+	header.sliceBias = -CLUSTER_Z * log(zNear) / logRatio;
+	header.gridSize = uvec4(CLUSTER_X, CLUSTER_Y, CLUSTER_Z, 0);
+
+	//respecified every frame so the driver doesn't have to wait on last frame's draws,
+	//an empty light list still gets a buffer so the binding stays valid
+	PointLight none = {};
+	glNamedBufferData(lightBuffer, std::max<size_t>(lights.size(), 1) * sizeof(PointLight), lights.empty() ? &none : lights.data(), GL_STREAM_DRAW);
+	glNamedBufferData(clusterBuffer, sizeof(header) + grid.size() * sizeof(GLuint), nullptr, GL_STREAM_DRAW);
+	glNamedBufferSubData(clusterBuffer, 0, sizeof(header), &header);
+	glNamedBufferSubData(clusterBuffer, sizeof(header), grid.size() * sizeof(GLuint), grid.data());
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, POINT_LIGHT_BINDING, lightBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_CLUSTER_BINDING, clusterBuffer);
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "Light.h"
+
+using namespace glm;
+using namespace std;
+
+//Storage buffer binding points, must match the layout(binding = N) in fragment.frag
+const GLuint POINT_LIGHT_BINDING = 2;
+const GLuint LIGHT_CLUSTER_BINDING = 3;
+
+//View space froxel grid: tiles across the screen, depth slices spaced exponentially from near to far
+const int CLUSTER_X = 16;
+const int CLUSTER_Y = 9;
+const int CLUSTER_Z = 24;
+const int CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+
+//a point light is culled where its brightest color channel falls below this
+const float LIGHT_CUTOFF = 1.0f / 256.0f;
+
+//layout(std430, binding = 3) buffer LightClusters, followed by the light grid:
+//(offset, count) per cluster, then the light indices the offsets point into
+struct LightClusterHeader {
+	vec2 tileScale;				//clusters per pixel in x and y
+	float sliceScale;			//slice = log(view depth) * sliceScale + sliceBias
+	float sliceBias;
+	uvec4 gridSize;				//CLUSTER_X, CLUSTER_Y, CLUSTER_Z, unused
+};
+
+static_assert(sizeof(LightClusterHeader) == 32, "cluster header must match the std430 layout");
+
+//Assigns the point lights of a frame to the clusters they reach, on the CPU. The fragment
+//shader looks up its cluster and only shades the lights listed there, so the per pixel
+//cost depends on how many lights overlap a pixel, not on how many lights there are.
+class LightClusters
+{
+public:
+	LightClusters();
+	~LightClusters();
+
+	LightClusters(const LightClusters&) = delete;
+	LightClusters& operator=(const LightClusters&) = delete;
+
+	//lights are in world space, the projection parameters must match the camera block
+	void update(const vector<PointLight>& lights, const mat4& view, float fovy, float aspect, float zNear, float zFar, ivec2 viewport);
+
+	//distance at which the light's contribution drops below LIGHT_CUTOFF
+	static float lightRadius(const PointLight& light, float maxRadius);
+
+private:
+	struct ClusterBounds {
+		vec3 min, max;
+	};
+
+	GLuint lightBuffer, clusterBuffer;
+	vector<ClusterBounds> bounds;		//view space, rebuilt when the projection changes
+	vec4 boundsProjection;				//fovy, aspect, near, far the bounds were built for
+	vector<GLuint> grid;
+	vector<uvec2> assignments;			//(cluster, light) pairs of this frame
+
+	void buildBounds(float fovy, float aspect, float zNear, float zFar);
+	float sliceDepth(int slice, float zNear, float zFar) const;
+};
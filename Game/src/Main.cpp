@@ -12,6 +12,7 @@
 #include <GLFW/glfw3.h>
 #include "Utils.h"
 #include "Shader.h"
+#include "ShaderVariants.h"
 #include "VAO.h"
 #include "VBO.h"
 #include "EBO.h"
@@ -28,11 +29,21 @@
 #include <assimp/postprocess.h>
 #include "Terrain.h"
 #include "HeightMap.h"
+#include "Physics.h"
+#include "UBO.h"
+#include "Light.h"
+#include "LightClusters.h"
+#include "ShadowCascades.h"
+#include "OcclusionCuller.h"
+#include "AabbTree.h"
+#include "RenderQueue.h"
+#include "Benchmark.h"
+#include "AssetLoader.h"
+#include "Font.h"
+#include "TextRenderer.h"
 #include "btBulletCollisionCommon.h"
 #include "btBulletDynamicsCommon.h"
 #include "BulletCollision/CollisionShapes/btStaticPlaneShape.h"
-#include <ft2build.h>
-#include FT_FREETYPE_H
 
 using namespace glm;
 
@@ -49,17 +60,28 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow* window);
 void mouse_callback(GLFWwindow* window, double xPos, double yPos);
 void readSettings(string source);
+void parseArguments(int argc, char** argv);
 void windowSetup();
 void setWindowMode();
 void updateFrameTime();
-void updateShaderMatrices(Shader& shader, Shader& collisionShader);
-void setGeneralLight(Shader& shader);
-void renderText(string text, Shader& textShader, VAO& textVAO, VBO& textVBO, float x, float y, float scale, vec3 textColor);
-void renderTerrain(Shader& shader, Model& terrainModel);
-void renderModel(Model& model, Shader& shader, vec3 translation, vec3 scaling, float rotationAngle, vec3 rotationAxis);
-void renderCollisionShape(Geometry& collisionShape, Shader& collisionShader, vec3 translation, vec3 scaling, float rotationAngle, vec3 rotationAxis);
-void renderSuns(Shader& shader, vec3 sunPos[], Texture& redSunTex, Texture& blueSunTex, Model& redSunModel, Model& blueSunModel);
-void renderTrees(Shader& shader, Model& treeModel);
+void updateTerrainStats(const Terrain& terrain);
+void updateCameraBlock(UBO& cameraUBO);
+void updateLightBlock(UBO& lightUBO);
+void updatePointLights(LightClusters& lightClusters, vec3 sunPos[]);
+void setMaterial(Shader& shader);
+void renderTerrain(Terrain& terrain, Shader& terrainShader);
+mat4 modelMatrix(vec3 translation, vec3 scaling, float rotationAngle, vec3 rotationAxis);
+void renderCollisionShape(Geometry& collisionShape, Shader& collisionShader, mat4 bodyMatrix, vec3 translation, vec3 scaling, float rotationAngle, vec3 rotationAxis);
+void renderSuns(RenderQueue& queue, ShaderVariants& shader, vec3 sunPos[], Texture& redSunTex, Texture& blueSunTex, Model& redSunModel, Model& blueSunModel);
+void placeObjects(const Terrain& terrain);
+vector<mat4> createTreeTransforms(const Terrain& terrain);
+vector<vec3> createLampPositions(int count, const Terrain& terrain);
+void renderTrees(RenderQueue& queue, ShaderVariants& shader, Model& treeModel, const uint8_t* visibility = nullptr);
+void updateOccluders(OcclusionCuller& culler, Terrain& terrain, Model& houseModel);
+void updateSceneBounds(Model& houseModel, Model& wizardModel, Model& treeModel);
+void addSceneObject(uint32_t object, Model& model, const mat4& transform);
+void cullScene(Model& houseModel, Model& wizardModel, Model& treeModel, OcclusionCuller* culler);
+void renderShadowCasters(RenderQueue& queue, ShaderVariants& shadowShader, const mat4& lightMatrix, const function<void(ShaderVariants&)>& submit);
 void renderBrightnessOverlay(Shader& quadShader, VAO& quadVAO);
 
 
@@ -69,6 +91,7 @@ void renderBrightnessOverlay(Shader& quadShader, VAO& quadVAO);
 
 static bool _wireframe = false;
 static bool _culling = false;
+static bool _occlusion = true;
 static bool _dragging = false;
 static bool _strafing = false;
 static bool _fullscreen = false;
@@ -84,31 +107,60 @@ float brightnessOffset = 0.0f;
 //frame time
 float deltaTime = 0.0f, lastFrame = 0.0f, currentFrame = 0.0f;
 string fpsString = "";
+int fpsValue = -1;		//frame rate shown in fpsString, the string is only rebuilt when it changes
+string terrainString = "";
+size_t terrainTiles = size_t(-1), terrainChunks = size_t(-1);		//shown in terrainString, rebuilt the same way
 
 //mouse cursor
 bool firstMouse = true;
 float lastX = 0, lastY = 0;
 
+//Benchmark (--benchmark) and camera path recording (--record <file>)
+bool benchmarkMode = false;
+BenchmarkSettings benchmarkSettings;
+Benchmark* benchmark = nullptr;
+string recordPath = "";
+CameraPath recordedPath;
+unsigned int recordKeys = 0;
+float recordMouseX = 0.0f, recordMouseY = 0.0f;
+
 //Camera
 Camera cam;
 mat4 viewMatrix = cam.getViewMatrix();
+Frustum viewFrustum;		//updated with the camera block, used for culling
+mat4 viewProjection;
+
+//Terrain
+TerrainSettings terrainSettings;
+
+//Asset loading, milliseconds per frame spent on GL uploads of loaded assets
+float uploadBudget = 2.0f;
+
+//Shadows of the first directional light
+ShadowSettings shadowSettings;
+vec3 sunDirection = vec3(0.0f, -1.0f, 0.0f);
+
+//Occlusion culling of the camera pass, terrain cells and the house hull hide what is behind them
+OcclusionSettings occlusionSettings;
+vector<vec3> terrainOccluders;		//reused every frame
+
+//Scene bounds, a leaf per object in world space, the camera pass draws what the frustum query and the occlusion test leave
+enum SceneObject { SCENE_HOUSE, SCENE_WIZARD, SCENE_TREES };		//tree instance i is SCENE_TREES + i
+AabbTree sceneTree;
+vector<int> sceneProxies;			//leaf per object, -1 until its model is ready
+vector<uint32_t> visibleObjects;
+vector<uint8_t> sceneVisibility;	//a byte per object, read when the queue is executed
+
+//placement of the house (also an occluder) and the wizard, on the ground once the terrain is open
+mat4 houseTransform(1.0f);
+mat4 wizardTransform(1.0f);
+
+//Floating lamps, small point lights assigned to clusters together with the suns
+int lampCount = 200;
+vector<vec3> lampPositions;
 
 //Physics
-btDynamicsWorld* world;
-btDispatcher* dispatcher;
-btDefaultCollisionConfiguration* collisionConfig;
-btBroadphaseInterface* broadphase;
-btConstraintSolver* solver;
-vector<btRigidBody*> bodies;
-
-//Text Rendering
-struct Character {			/// Holds all state information relevant to a character as loaded using FreeType
-	unsigned int	textureID; // ID handle of the glyph texture
-	ivec2			size;      // Size of glyph
-	ivec2			bearing;   // Offset from baseline to left/top of glyph
-	unsigned int	advance;   // Horizontal offset to advance to next glyph
-};
-map<GLchar, Character> Characters;
+Physics* physics;
 
 
 /* --------------------------------------------- */
@@ -118,17 +170,8 @@ map<GLchar, Character> Characters;
 int main(int argc, char** argv)
 {
 	readSettings("assets/settings.ini");
+	parseArguments(argc, argv);
 	
-	//heightmap texture dimensions and half dimensions
-	const int TERRAIN_WIDTH = 1024;
-	const int TERRAIN_DEPTH = 1024;
-	const int TERRAIN_HALF_WIDTH = TERRAIN_WIDTH >> 1;
-	const int TERRAIN_HALF_DEPTH = TERRAIN_DEPTH >> 1;
-
-	//heightmap height scale and half scale values
-	float heightMapScale = 150;
-	float heightMapHalfScale = heightMapScale / 2.0f;
-
 	/* --------------------------------------------- */
 	// Create context
 	/* --------------------------------------------- */
@@ -149,6 +192,8 @@ int main(int argc, char** argv)
 
 	setWindowMode();
 
+	if (benchmarkMode) glfwSwapInterval(0);		//measure the frame, not the display refresh
+
 	if (glDebugMessageCallback != NULL) {// Register your callback function.
 		glDebugMessageCallback(DebugCallbackDefault, NULL);
 		glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);  // Enable synchronous callback. This ensures that your callback function is called right after an error has occurred.
@@ -300,48 +345,49 @@ int main(int argc, char** argv)
 
 
 	//Load and initialize shaders
-	Shader shader("assets/shader/vertex.vert", "assets/shader/fragment.frag");
-	shader.use();
-	shader.setInt("material.diffuse", 0);
-	//shader.setInt("material.specular", 1);
+	//one variant per combination of material maps, compiled the first time a mesh needs it
+	string lightDefines = "#define NR_DIR_LIGHTS " + to_string(NR_DIR_LIGHTS) + "\n#define SHADOW_CASCADES " + to_string(SHADOW_CASCADES) + "\n";
+	ShaderVariants shader("assets/shader/vertex.vert", "assets/shader/fragment.frag", lightDefines, setMaterial);
+
+	//Camera and light data shared by every program through uniform blocks
+	UBO cameraUBO(sizeof(CameraBlock), CAMERA_BLOCK_BINDING);
+	UBO lightUBO(sizeof(LightBlock), LIGHT_BLOCK_BINDING);
+	LightClusters lightClusters;		//point lights, sorted into view space clusters every frame
+
+	//depth only, materials don't matter so every mesh shares one variant
+	ShadowCascades shadows(shadowSettings);
+	ShaderVariants shadowShader("assets/shader/shadowVertex.vert", "assets/shader/shadowFragment.frag", "", nullptr, 0);
+	Shader terrainShadowShader("assets/shader/terrainShadowVertex.vert", "assets/shader/shadowFragment.frag");
 
 	Shader lampShader("assets/shader/lampVertex.vert", "assets/shader/lampFragment.frag");
-	Shader terrainShader("assets/shader/terrainVertex.vert", "assets/shader/terrainFragment.frag");
+	Shader terrainShader("assets/shader/terrainVertex.vert", "assets/shader/terrainFragment.frag", lightDefines);
 	Shader woodShader("assets/shader/woodVertex.vert", "assets/shader/woodFragment.frag");
 	Shader quadShader("assets/shader/quadVertex.vert", "assets/shader/quadFragment.frag");
 
 
 
 	//---------------------Models-------------------------------
-	Model treeModel("assets/models/tree/tree low.obj");
-	Model houseModel("assets/models/house/house.obj");
-	Model wizardModel("assets/models/sorcerer/wizard.obj");
-	Model redSunModel("assets/models/sunRed/redSun.obj");
-	Model blueSunModel("assets/models/sunBlue/sunBlue.obj");
-	Model terrainModelC("assets/models/Terrain/terrain.obj");
+	//parsed and decoded in the background, uploaded a bit every frame and drawn once ready
+	AssetLoader assetLoader;
+	Model treeModel, houseModel, wizardModel, redSunModel, blueSunModel;
+	assetLoader.loadModel(treeModel, "assets/models/tree/tree low.obj");
+	assetLoader.loadModel(houseModel, "assets/models/house/house.obj");
+	assetLoader.loadModel(wizardModel, "assets/models/sorcerer/wizard.obj");
+	assetLoader.loadModel(redSunModel, "assets/models/sunRed/redSun.obj");
+	assetLoader.loadModel(blueSunModel, "assets/models/sunBlue/sunBlue.obj");
+
+	//tiles are streamed in around the camera, chunks are picked every frame by distance and visibility
+	Terrain terrain(terrainSettings);
 
-	//Terrain terrain;
-	//terrain.generateTerrain();
+	//everything stands on the terrain, its heights are known as soon as the archive is open
+	placeObjects(terrain);
+	treeModel.setInstances(createTreeTransforms(terrain));		//the forest is static, its transforms are built once
+	lampPositions = createLampPositions(lampCount, terrain);
 
 
 	//----------------------Physics------------------------------
-	collisionConfig = new btDefaultCollisionConfiguration();
-	dispatcher = new btCollisionDispatcher(collisionConfig);
-	broadphase = new btDbvtBroadphase();
-	solver = new btSequentialImpulseConstraintSolver();
-	world = new btDiscreteDynamicsWorld(dispatcher, broadphase, solver, collisionConfig);
-	world->setGravity(btVector3(0, -9.8, 0));
-
-
-	btTransform t;
-	t.setIdentity();
-	t.setOrigin(btVector3(0, 0, 0));
-	btStaticPlaneShape* plane = new btStaticPlaneShape(btVector3(0, 1, 0), btScalar(0));
-	btMotionState* motion = new btDefaultMotionState(t);
-	btRigidBody::btRigidBodyConstructionInfo info(0.0, motion, plane);
-	btRigidBody* body = new btRigidBody(info);
-	world->addRigidBody(body);
-	bodies.push_back(body);
+	physics = new Physics(1.0f / 60.0f);		//fixed 60Hz simulation on its own thread
+	terrain.attachPhysics(physics);				//resident terrain tiles collide through heightfields over their samples
 
 	Shader collisionShader("assets/shader/collisionVertex.vert", "assets/shader/collisionFragment.frag");
 	Geometry testCollisionShape = Geometry(mat4(1.0f), Geometry::createPlaneGeometry(100.0f, 100.0f));
@@ -350,72 +396,58 @@ int main(int argc, char** argv)
 	//Geometry testCollisionShape = Geometry(mat4(1.0f), Geometry::createSphereGeometry(16,16,30.0f));
 
 	//------------------------Text Rendering---------------------
-	FT_Library ft;																												//init
-	if (FT_Init_FreeType(&ft)) std::cout << "ERROR::FREETYPE: Could not init FreeType Library" << std::endl;					//init
-	FT_Face face;																												//init
-	if (FT_New_Face(ft, "assets/fonts/arial.ttf", 0, &face)) std::cout << "ERROR::FREETYPE: Failed to load font" << std::endl;	//init
-
-	FT_Set_Pixel_Sizes(face, 0, 48);										//Font size (width == 0 -> width is dynamically calculated!)
-	
-	if (FT_Load_Char(face, 'X', FT_LOAD_RENDER)) std::cout << "ERROR::FREETYTPE: Failed to load Glyph" << std::endl;			//Load character "X" for testing init
+	//glyphs share one atlas texture (other than ASCII added on first use), all text of a frame is one draw
+	Font font("assets/fonts/arial.ttf", 48);
+	TextRenderer textRenderer(font);
 
 	Shader textShader("assets/shader/textVertex.vert", "assets/shader/textFragment.frag");
 	mat4 textProjection = ortho(0.0f, static_cast<float>(windowWidth), 0.0f, static_cast<float>(windowHeight));
 	textShader.use();
 	textShader.setMat4("projection", 1, GL_FALSE, textProjection);
 
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // disable byte-alignment restriction
-
-	for (unsigned char c = 0; c < 128; c++) {
-		
-		if (FT_Load_Char(face, c, FT_LOAD_RENDER)) {	// load character glyph 
-			cout << "FREETYPE: Failed to load Glyph" << std::endl;
-			continue;
-		}
-		
-		unsigned int charTexture;		// generate texture
-		glGenTextures(1, &charTexture);
-		glBindTexture(GL_TEXTURE_2D, charTexture);
-		glTexImage2D(GL_TEXTURE_2D,	0, GL_RED, face->glyph->bitmap.width, face->glyph->bitmap.rows,	0, GL_RED, GL_UNSIGNED_BYTE, face->glyph->bitmap.buffer);
-
-		// set texture options
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		// store character for later use
-		Character character = {
-			charTexture,
-			ivec2(face->glyph->bitmap.width, face->glyph->bitmap.rows),
-			ivec2(face->glyph->bitmap_left, face->glyph->bitmap_top),
-			face->glyph->advance.x
-		};
-		Characters.insert(pair<char, Character>(c, character));
-	}
-
-	glBindTexture(GL_TEXTURE_2D, 0);
-	// clear FreeType resources when finished
-	FT_Done_Face(face);
-	FT_Done_FreeType(ft);
-
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-	VAO textVAO;
-	VBO textVBO(sizeof(float) * 6 * 4);
-	textVAO.addText(textVBO);
-	textVBO.unbind();
-	textVAO.unbind();
-
 
 
 #pragma endregion
 	/* --------------------------------------------- */
 	// Initialize scene and render loop
 	/* --------------------------------------------- */
+	RenderQueue renderQueue;
+	OcclusionCuller occlusionCuller(occlusionSettings);
+	_occlusion = occlusionSettings.enabled;
+
+	//static casters go into the cached cascades, the wizard could walk around so he is drawn every frame
+	//only the camera pass passes a visibility per SceneObject, what the camera can't see may still cast a shadow into view
+	auto renderStaticModels = [&](ShaderVariants& shaders, const uint8_t* visibility) {
+		if (!visibility || visibility[SCENE_HOUSE]) renderQueue.submit(shaders, houseModel, houseTransform);
+		renderTrees(renderQueue, shaders, treeModel, visibility ? visibility + SCENE_TREES : nullptr);
+	};
+	auto renderDynamicModels = [&](ShaderVariants& shaders, const uint8_t* visibility) {
+		if (!visibility || visibility[SCENE_WIZARD]) renderQueue.submit(shaders, wizardModel, wizardTransform);
+	};
+	ShadowCascades::DrawCasters renderStaticShadows = [&](const mat4& lightMatrix, const Frustum& frustum) {
+		terrain.select(cam.camPosition, frustum);
+		terrainShadowShader.use();
+		terrainShadowShader.setMat4("lightMatrix", 1, GL_FALSE, lightMatrix);
+		terrain.draw(terrainShadowShader);
+		renderShadowCasters(renderQueue, shadowShader, lightMatrix, [&](ShaderVariants& shaders) { renderStaticModels(shaders, nullptr); });
+	};
+	ShadowCascades::DrawCasters renderDynamicShadows = [&](const mat4& lightMatrix, const Frustum& frustum) {
+		renderShadowCasters(renderQueue, shadowShader, lightMatrix, [&](ShaderVariants& shaders) { renderDynamicModels(shaders, nullptr); });
+	};
+
+	if (benchmarkMode) {
+		assetLoader.finish();		//measure the complete scene from the first frame on
+		terrain.finish(cam.camPosition);
+		benchmark = new Benchmark(benchmarkSettings, windowWidth, windowHeight);
+	}
+	else physics->start();		//the benchmark steps physics on the main thread so runs are repeatable
 	{
-		while (!glfwWindowShouldClose(window)) {
+		while (!glfwWindowShouldClose(window) && !(benchmark && benchmark->isFinished())) {
+			if (benchmark) benchmark->beginFrame();
+
 			// Clear backbuffer
 			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 			glfwPollEvents();
@@ -424,38 +456,69 @@ int main(int argc, char** argv)
 			// Camera & Lighting
 			processInput(window);
 			updateFrameTime();
-			updateShaderMatrices(shader, collisionShader);
-			setGeneralLight(shader);
+			updateCameraBlock(cameraUBO);
+			updateLightBlock(lightUBO);
+			updatePointLights(lightClusters, sunPos);
+			assetLoader.update(uploadBudget);
+			terrain.update(cam.camPosition);
+			renderQueue.setLodProjection(float(_fullscreen ? screenHeight : windowHeight), radians(cam.camFOV));
+
+			//Shadows, the static cache only changes when the cascades move or tiles/models arrive;
+			//residency only grows and models only become ready, so the sum changes with every one of them
+			uint64_t staticShadowVersion = terrain.getResidencyVersion() + houseModel.isReady() + treeModel.isReady();
+			shadows.update(cam.getViewMatrix(), radians(cam.camFOV), aspectRatio, zNear, sunDirection, staticShadowVersion);
+			shadows.render(renderStaticShadows, renderDynamicShadows);
+			shadows.bind();
+
+			//Visibility, worked out on the CPU while the GPU works on the shadows
+			updateSceneBounds(houseModel, wizardModel, treeModel);
+			if (_occlusion) updateOccluders(occlusionCuller, terrain, houseModel);
+			cullScene(houseModel, wizardModel, treeModel, _occlusion ? &occlusionCuller : nullptr);
 			
 			//Render Objects
-			renderTerrain(shader, terrainModelC);
-			renderSuns(shader, sunPos, redSunTex, blueSunTex, redSunModel, blueSunModel);
-			renderModel(wizardModel, shader, vec3(-7.0f, -0.2f, 3.0f), vec3(0.005f, 0.005f, 0.005f), 0.0f, vec3(1.0f));
-			renderModel(houseModel, shader, vec3(-5.0f, -0.75f, -5.0f), vec3(0.2f, 0.22, 0.2f), 0.0f, vec3(1.0f));
-			renderTrees(shader, treeModel);			
-			renderCollisionShape(testCollisionShape, collisionShader, vec3(0.0f, 100.0f, 20.0f), vec3(1.0f), 0.0f, vec3(1.0f));
+			renderTerrain(terrain, terrainShader);
+			renderSuns(renderQueue, shader, sunPos, redSunTex, blueSunTex, redSunModel, blueSunModel);
+			renderStaticModels(shader, sceneVisibility.data());
+			renderDynamicModels(shader, sceneVisibility.data());
+			renderQueue.execute(cam.camPosition);		//sorted by state, drawn and cleared
+			renderCollisionShape(testCollisionShape, collisionShader, mat4(1.0f), vec3(0.0f, 100.0f, 20.0f), vec3(1.0f), 0.0f, vec3(1.0f));
 
 			renderBrightnessOverlay(quadShader, quadVAO);
-			renderText(fpsString, textShader, textVAO, textVBO, 25.0f, 25.0f, 1.0f, vec3(0.05f, 0.05f, 0.05f));
-			//Physics
-			world->stepSimulation(deltaTime);
+			updateTerrainStats(terrain);
+			textRenderer.add(fpsString, 25.0f, 25.0f, 1.0f, vec3(0.05f, 0.05f, 0.05f));
+			textRenderer.add(terrainString, 25.0f, 80.0f, 0.6f, vec3(0.05f, 0.05f, 0.05f));
+			textRenderer.draw(textShader);
+
+			if (benchmark) {
+				physics->update(deltaTime);
+				benchmark->endSubmit();
+			}
+			if (!recordPath.empty()) {
+				recordedPath.record(recordKeys, recordMouseX, recordMouseY, deltaTime);
+				recordMouseX = recordMouseY = 0.0f;
+			}
 
 			// Swap buffers
 			glfwSwapBuffers(window);
+			if (benchmark) benchmark->endFrame();
 		}
 	}
 
+	if (benchmark) {
+		benchmark->writeResults();
+		delete benchmark;
+	}
+	if (!recordPath.empty()) recordedPath.save(recordPath);
+
 
 	/* --------------------------------------------- */
 	// Destroy framework
 	/* --------------------------------------------- */
 	destroyFramework();
 
-	delete dispatcher;
-	delete collisionConfig;
-	delete solver;
-	delete world;
-	delete broadphase;
+	physics->stop();
+	terrain.detachPhysics();
+	delete physics;
 
 	/* --------------------------------------------- */
 	// Destroy context and exit
@@ -481,6 +544,62 @@ void readSettings(string source) {
 	//float fovy = float(reader.GetReal("camera", "fovy", 60.0f));
 	zNear = float(reader.GetReal("camera", "near", 0.1f));
 	zFar = float(reader.GetReal("camera", "far", 500.0f));
+
+	//benchmark
+	benchmarkSettings.frames = reader.GetInteger("benchmark", "frames", benchmarkSettings.frames);
+	benchmarkSettings.offscreen = reader.GetBoolean("benchmark", "offscreen", benchmarkSettings.offscreen);
+	benchmarkSettings.cameraPath = reader.Get("benchmark", "camera_path", benchmarkSettings.cameraPath);
+	benchmarkSettings.output = reader.Get("benchmark", "output", benchmarkSettings.output);
+
+	//assets
+	uploadBudget = float(reader.GetReal("assets", "upload_budget_ms", uploadBudget));
+
+	// lights
+	lampCount = reader.GetInteger("lights", "lamps", lampCount);
+
+	// shadows
+	shadowSettings.resolution = reader.GetInteger("shadows", "resolution", shadowSettings.resolution);
+	shadowSettings.distance = float(reader.GetReal("shadows", "distance", shadowSettings.distance));
+
+	// occlusion
+	occlusionSettings.enabled = reader.GetBoolean("occlusion", "enabled", occlusionSettings.enabled);
+	occlusionSettings.width = reader.GetInteger("occlusion", "width", occlusionSettings.width);
+	occlusionSettings.height = reader.GetInteger("occlusion", "height", occlusionSettings.height);
+	occlusionSettings.terrainDistance = float(reader.GetReal("occlusion", "terrain_distance", occlusionSettings.terrainDistance));
+	occlusionSettings.terrainLevel = reader.GetInteger("occlusion", "terrain_level", occlusionSettings.terrainLevel);
+
+	//terrain
+	terrainSettings.heightMap = reader.Get("terrain", "height_map", terrainSettings.heightMap);
+	terrainSettings.size = float(reader.GetReal("terrain", "size", terrainSettings.size));
+	terrainSettings.heightScale = float(reader.GetReal("terrain", "height_scale", terrainSettings.heightScale));
+	terrainSettings.tileSize = float(reader.GetReal("terrain", "tile_size", terrainSettings.tileSize));
+	terrainSettings.tileSamples = reader.GetInteger("terrain", "tile_samples", terrainSettings.tileSamples);
+	terrainSettings.gridSize = reader.GetInteger("terrain", "chunk_grid", terrainSettings.gridSize) & ~1;
+	terrainSettings.lodLevels = reader.GetInteger("terrain", "lod_levels", terrainSettings.lodLevels);
+	terrainSettings.lodDistance = float(reader.GetReal("terrain", "lod_distance", terrainSettings.lodDistance));
+	terrainSettings.streamDistance = float(reader.GetReal("terrain", "stream_distance", terrainSettings.streamDistance));
+	terrainSettings.memoryBudget = reader.GetInteger("terrain", "memory_budget_mb", terrainSettings.memoryBudget);
+}
+
+void parseArguments(int argc, char** argv) {
+	//	--benchmark [--frames N] [--camera-path file] [--offscreen] [--output prefix]
+	//	--record file		records the camera flight of a normal session for later benchmarks
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--benchmark") benchmarkMode = true;
+		else if (arg == "--offscreen") benchmarkSettings.offscreen = true;
+		else if (arg == "--frames" && hasValue) benchmarkSettings.frames = atoi(argv[++i]);
+		else if (arg == "--camera-path" && hasValue) benchmarkSettings.cameraPath = argv[++i];
+		else if (arg == "--output" && hasValue) benchmarkSettings.output = argv[++i];
+		else if (arg == "--record" && hasValue) recordPath = argv[++i];
+		else cout << "Unknown argument: " << arg << endl;
+	}
+
+	if (benchmarkMode) {
+		_fullscreen = false;
+		recordPath = "";
+	}
 }
 
 void windowSetup() {
@@ -491,6 +610,7 @@ void windowSetup() {
 	glfwWindowHint(GLFW_REFRESH_RATE, refreshRate); // Set refresh rate
 	glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
 	glfwWindowHint(GLFW_SAMPLES, 4);	// Enable antialiasing (4xMSAA)
+	if (benchmarkMode && benchmarkSettings.offscreen) glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);	// render into the benchmark framebuffer only
 
 	// Window Setup
 	monitor = glfwGetPrimaryMonitor();
@@ -535,19 +655,27 @@ void mouse_callback(GLFWwindow* window, double xPos, double yPos) {
 	lastX = xPos;
 	lastY = yPos;
 
-	if (_dragging) {
+	if (_dragging && !benchmarkMode) {
 		cam.processMouseMovement(-xOffset, -yOffset);
+		recordMouseX -= xOffset;
+		recordMouseY -= yOffset;
 	}
 
 	//cam.processMouseMovement(xOffset, yOffset);
 }
 
 void processInput(GLFWwindow* window) {
+	if (benchmark) {
+		benchmark->getCameraPath().apply(cam, benchmark->getFrameIndex());
+		return;
+	}
+
 	//float cameraSpeed = 4.5f * deltaTime;
-	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)	cam.processKeyboard(FORWARD, deltaTime);
-	if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)	cam.processKeyboard(BACKWARD, deltaTime);
-	if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)	cam.processKeyboard(LEFT, deltaTime);
-	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)	cam.processKeyboard(RIGHT, deltaTime);
+	recordKeys = 0;
+	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) { cam.processKeyboard(FORWARD, deltaTime);	recordKeys |= 1 << FORWARD; }
+	if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) { cam.processKeyboard(BACKWARD, deltaTime);	recordKeys |= 1 << BACKWARD; }
+	if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) { cam.processKeyboard(LEFT, deltaTime);		recordKeys |= 1 << LEFT; }
+	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) { cam.processKeyboard(RIGHT, deltaTime);	recordKeys |= 1 << RIGHT; }
 }
 
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods){
@@ -567,6 +695,9 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 		if (_culling) glEnable(GL_CULL_FACE);
 		else glDisable(GL_CULL_FACE);
 		break;
+	case GLFW_KEY_F3:						//Occlusion Culling Toggle			F3
+		_occlusion = !_occlusion;
+		break;
 
 	case GLFW_KEY_F5:						//Fullscreen Toggle					F5
 		_fullscreen = !_fullscreen;
@@ -603,16 +734,14 @@ void setWindowMode() {
 	}
 }
 
-void updateShaderMatrices(Shader& shader, Shader& collisionShader) {
-	mat4 viewMatrix = cam.getViewMatrix();
-	mat4 projectionMatrix = perspective(radians(cam.camFOV), aspectRatio, zNear, zFar);
-	shader.use();
-	shader.setVec3("viewPos", 1, cam.camPosition);
-	shader.setMat4("viewMatrix", 1, GL_FALSE, viewMatrix);
-	shader.setMat4("projectionMatrix", 1, GL_FALSE, projectionMatrix);
-	collisionShader.use();
-	collisionShader.setMat4("viewMatrix", 1, GL_FALSE, viewMatrix);
-	collisionShader.setMat4("projectionMatrix", 1, GL_FALSE, projectionMatrix);
+void updateCameraBlock(UBO& cameraUBO) {
+	CameraBlock block;
+	block.viewMatrix = cam.getViewMatrix();
+	block.projectionMatrix = perspective(radians(cam.camFOV), aspectRatio, zNear, zFar);
+	viewProjection = block.projectionMatrix * block.viewMatrix;
+	viewFrustum = Frustum(viewProjection);
+	block.viewPos = cam.camPosition;
+	cameraUBO.update(&block, sizeof(block));
 }
 
 void updateFrameTime() {
@@ -620,161 +749,228 @@ void updateFrameTime() {
 	currentFrame = (float)glfwGetTime();
 	deltaTime = currentFrame - lastFrame;
 	lastFrame = currentFrame;
-	fpsString = "Frame rate: " + to_string(1.0f / deltaTime).substr(0, 4) + "fps";
+	if (benchmark) deltaTime = 1.0f / 60.0f;		//fixed simulation step, independent of how fast frames render
+	int fps = deltaTime > 0.0f ? int(1.0f / deltaTime + 0.5f) : 0;
+	if (fps != fpsValue) {
+		fpsValue = fps;
+		fpsString = "Frame rate: " + to_string(fps) + "fps";
+	}
+}
+
+void updateTerrainStats(const Terrain& terrain) {
+	//resident tiles and the chunks drawn by the camera pass
+	if (terrain.getResidentTileCount() != terrainTiles || terrain.getChunkCount() != terrainChunks) {
+		terrainTiles = terrain.getResidentTileCount();
+		terrainChunks = terrain.getChunkCount();
+		terrainString = "Terrain: " + to_string(terrainTiles) + " tiles, " + to_string(terrainChunks) + " chunks";
+	}
 }
 
 
 //------------------------Rendering functions---------------------------
-void setGeneralLight(Shader& shader) {
+void setMaterial(Shader& shader) {
 	shader.use();
 	//material properties
 	//ambient and diffuse should be set to similar values as the material/texture color
-	shader.setVec3("material.specular", 1, glm::vec3(0.6f, 0.6f, 0.6f));  //specular is the shiny part
+	shader.setVec3("material.color", 1, glm::vec3(0.8f, 0.8f, 0.8f));		//used by meshes without a diffuse map
+	shader.setVec3("material.specular", 1, glm::vec3(0.6f, 0.6f, 0.6f));  //specular is the shiny part, used by meshes without a specular map
 	shader.setFloat("material.shininess", 32);	//shininess changes the appearance of the specular light, e.g. 16 -> large reflection, 256 -> small reflection 
-	shader.setVec3("dirLights[0].direction", 1, vec3(0.0f, -1.0f, 0.0f));
-	shader.setVec3("dirLights[0].ambient", 1, vec3(0.03, 0.03f, 0.03f)); //ambient is set rather low so different objects don't brighten each other up too much
-	shader.setVec3("dirLights[0].diffuse", 1, vec3(0.5f, 0.5f, 0.5f));
-	shader.setVec3("dirLights[0].specular", 1, vec3(0.5f, 0.5f, 0.5f));
 }
 
-void renderText(string text, Shader& textShader, VAO& textVAO, VBO& textVBO, float x, float y, float scale, vec3 textColor)
-{
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+void updateLightBlock(UBO& lightUBO) {
+	LightBlock block = {};
 
-	textShader.use();
-	textShader.setVec3("textColor", 1, textColor);
-	glActiveTexture(GL_TEXTURE0);
-	textVAO.bind();
+	//	general light, casts the shadows
+	block.dirLights[0].direction = sunDirection;
+	block.dirLights[0].ambient = vec3(0.03, 0.03f, 0.03f); //ambient is set rather low so different objects don't brighten each other up too much
+	block.dirLights[0].diffuse = vec3(0.5f, 0.5f, 0.5f);
+	block.dirLights[0].specular = vec3(0.5f, 0.5f, 0.5f);
+	//	directional light (red)
+	block.dirLights[1].direction = vec3(0.2f, -1.0f, 0.3f);
+	block.dirLights[1].ambient = vec3(0.7, 0.0f, 0.0f);
+	block.dirLights[1].diffuse = vec3(0.5f, 0.5f, 0.5f);
+	block.dirLights[1].specular = vec3(0.7f, 0.1f, 0.1f);
+	//	directional light (blue)
+	block.dirLights[2].direction = vec3(-0.2f, -1.0f, -0.3f);
+	block.dirLights[2].ambient = vec3(0.0f, 0.0f, 0.7f);
+	block.dirLights[2].diffuse = vec3(0.5f, 0.5f, 0.5f);
+	block.dirLights[2].specular = vec3(0.1f, 0.1f, 0.7f);
 
-	// iterate through all characters
-	string::const_iterator c;
-	for (c = text.begin(); c != text.end(); c++)
-	{
-		Character ch = Characters[*c];
-
-		float xpos = x + ch.bearing.x * scale;
-		float ypos = y - (ch.size.y - ch.bearing.y) * scale;
-
-		float w = ch.size.x * scale;
-		float h = ch.size.y * scale;
-		// update VBO for each character
-		float vertices[6][4] = {
-			{ xpos,     ypos + h,   0.0f, 0.0f },
-			{ xpos,     ypos,       0.0f, 1.0f },
-			{ xpos + w, ypos,       1.0f, 1.0f },
-
-			{ xpos,     ypos + h,   0.0f, 0.0f },
-			{ xpos + w, ypos,       1.0f, 1.0f },
-			{ xpos + w, ypos + h,   1.0f, 0.0f }
-		};
-		// render glyph texture over quad
-		glBindTexture(GL_TEXTURE_2D, ch.textureID);
-		textVBO.bind(); // update content of VBO memory
-		glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
-		textVBO.unbind();
-		glDrawArrays(GL_TRIANGLES, 0, 6); // render quad
-		// now advance cursors for next glyph (note that advance is number of 1/64 pixels)
-		x += (ch.advance >> 6) * scale; // bitshift by 6 to get value in pixels (2^6 = 64)
-	}
-	glBindVertexArray(0);
-	glBindTexture(GL_TEXTURE_2D, 0);
-}
-
-void renderTerrain(Shader& shader, Model& terrainModel) {
-	shader.use();
-	mat4 terrainC = scale(mat4(1.0f), vec3(3.0f, 3.0f, 3.0f));
-	terrainC = translate(terrainC, vec3(0.0f, 45.0f, 0.0f));
-	shader.setMat4("modelMatrix", 1, GL_FALSE, terrainC);
-	terrainModel.draw(shader);
+	lightUBO.update(&block, sizeof(block));
+}
+
+void updatePointLights(LightClusters& lightClusters, vec3 sunPos[]) {
+	vector<PointLight> lights(2 + lampPositions.size());
+
+	//	point light (red sun)
+	lights[0].position = sunPos[0];
+	lights[0].ambient = vec3(0.5f, 0.0f, 0.0f);
+	lights[0].diffuse = vec3(1.0f, 0.2f, 0.2f);
+	lights[0].specular = vec3(1.0f, 0.2f, 0.2f);
+	lights[0].constant = 0.01f;
+	lights[0].linear = 0.0009f;
+	lights[0].quadratic = 0.000032f;
+	//	point light2 (blue sun)
+	lights[1].position = sunPos[1];
+	lights[1].ambient = vec3(0.0f, 0.0f, 0.5f);
+	lights[1].diffuse = vec3(0.2f, 0.2f, 1.0f);
+	lights[1].specular = vec3(0.2f, 0.2f, 1.0f);
+	lights[1].constant = 0.02f;
+	lights[1].linear = 0.00006f;
+	lights[1].quadratic = 0.000022f;
+
+	//	lamps, bobbing slowly around where they were placed
+	for (size_t i = 0; i < lampPositions.size(); i++) {
+		PointLight& lamp = lights[2 + i];
+		vec3 color = vec3(0.6f + 0.4f * sin(i * 1.3f), 0.6f + 0.4f * sin(i * 2.1f + 2.0f), 0.6f + 0.4f * sin(i * 0.7f + 4.0f));
+		lamp.position = lampPositions[i] + vec3(0.0f, 0.5f * sin(currentFrame + i), 0.0f);
+		lamp.ambient = color * 0.05f;
+		lamp.diffuse = color;
+		lamp.specular = color;
+		lamp.constant = 1.0f;
+		lamp.linear = 0.7f;
+		lamp.quadratic = 1.8f;
+	}
+
+	ivec2 viewport = _fullscreen ? ivec2(screenWidth, screenHeight) : ivec2(windowWidth, windowHeight);
+	lightClusters.update(lights, cam.getViewMatrix(), radians(cam.camFOV), aspectRatio, zNear, zFar, viewport);
+}
+
+void renderTerrain(Terrain& terrain, Shader& terrainShader) {
+	terrain.select(cam.camPosition, viewFrustum);
+	terrain.draw(terrainShader);
 }
 
-void renderModel(Model& model, Shader& shader, vec3 translation, vec3 scaling, float rotationAngle, vec3 rotationAxis) {
+mat4 modelMatrix(vec3 translation, vec3 scaling, float rotationAngle, vec3 rotationAxis) {
 	mat4 modelMat = translate(mat4(1.0f), translation);
 	modelMat = scale(modelMat, scaling);
 	modelMat = rotate(modelMat, radians(rotationAngle), rotationAxis);
-	shader.use();
-	shader.setMat4("modelMatrix", 1, GL_FALSE, modelMat);
-	model.draw(shader);
+	return modelMat;
 }
 
-void renderSuns(Shader& shader, vec3 sunPos[], Texture& redSunTex, Texture& blueSunTex, Model& redSunModel, Model& blueSunModel) {
+void renderSuns(RenderQueue& queue, ShaderVariants& shader, vec3 sunPos[], Texture& redSunTex, Texture& blueSunTex, Model& redSunModel, Model& blueSunModel) {
 	//---------------------SUNS-----------------------------------------
-	//	point light
-	shader.use();
-	shader.setVec3("pointLights[0].position", 1, sunPos[0] - vec3(0.0f, 0.0f, 0.0f));
-	shader.setVec3("pointLights[0].ambient", 1, vec3(0.5f, 0.0f, 0.0f));
-	shader.setVec3("pointLights[0].diffuse", 1, vec3(1.0f, 0.2f, 0.2f));
-	shader.setVec3("pointLights[0].specular", 1, vec3(1.0f, 0.2f, 0.2f));
-	shader.setFloat("pointLights[0].constant", 0.01f);
-	shader.setFloat("pointLights[0].linear", 0.0009f);
-	shader.setFloat("pointLights[0].quadratic", 0.000032f);
-	//	point light2
-	shader.setVec3("pointLights[1].position", 1, sunPos[1]);
-	shader.setVec3("pointLights[1].ambient", 1, vec3(0.0f, 0.0f, 0.5f));
-	shader.setVec3("pointLights[1].diffuse", 1, vec3(0.2f, 0.2f, 1.0f));
-	shader.setVec3("pointLights[1].specular", 1, vec3(0.2f, 0.2f, 1.0f));
-	shader.setFloat("pointLights[1].constant", 0.02f);
-	shader.setFloat("pointLights[1].linear", 0.00006f);
-	shader.setFloat("pointLights[1].quadratic", 0.000022f);
-	//	directional light (red)
-	shader.setVec3("dirLights[1].direction", 1, vec3(0.2f, -1.0f, 0.3f));
-	shader.setVec3("dirLights[1].ambient", 1, vec3(0.7, 0.0f, 0.0f));
-	shader.setVec3("dirLights[1].diffuse", 1, vec3(0.5f, 0.5f, 0.5f));
-	shader.setVec3("dirLights[1].specular", 1, vec3(0.7f, 0.1f, 0.1f));
-	//	directional light (blue)
-	shader.setVec3("dirLights[2].direction", 1, vec3(-0.2f, -1.0f, -0.3f));
-	shader.setVec3("dirLights[2].ambient", 1, vec3(0.0f, 0.0f, 0.7f));
-	shader.setVec3("dirLights[2].diffuse", 1, vec3(0.5f, 0.5f, 0.5f));
-	shader.setVec3("dirLights[2].specular", 1, vec3(0.1f, 0.1f, 0.7f));
-
-	redSunTex.bind();
+	//lights of the suns are point lights in the light clusters, see updatePointLights()
+	//the sun models have no textures of their own, they are drawn with the sun textures
 	mat4 redSun = translate(mat4(1.0f), sunPos[0]);
 	redSun = scale(redSun, vec3(0.2f, 0.2f, 0.2f));	// it's too big for our scene, so scale it down
-	shader.setMat4("modelMatrix", 1, GL_FALSE, redSun);
-	redSunModel.draw(shader);
+	queue.submit(shader, redSunModel, redSun, redSunTex.getId());
 
-	blueSunTex.bind();
 	mat4 blueSun = translate(mat4(1.0f), sunPos[1]);
 	blueSun = scale(blueSun, vec3(0.3f, 0.3f, 0.3f));	// it's too big for our scene, so scale it down
-	shader.setMat4("modelMatrix", 1, GL_FALSE, blueSun);
-	blueSunModel.draw(shader);
+	queue.submit(shader, blueSunModel, blueSun, blueSunTex.getId());
 }
 
-void renderTrees(Shader& shader, Model& treeModel) {
-	shader.use();
-	mat4 tree = translate(mat4(1.0f), vec3(0.0f, -0.75f, -3.0f));
-	tree = scale(tree, vec3(0.05f, 0.05f, 0.05f));	// it's too big for our scene, so scale it down
-	shader.setMat4("modelMatrix", 1, GL_FALSE, tree);
-	treeModel.draw(shader);
+void placeObjects(const Terrain& terrain) {
+	//the models' origins were placed on the old flat ground at y = -0.75, they keep their offsets to it
+	houseTransform = modelMatrix(vec3(-5.0f, terrain.getHeight(-5.0f, -5.0f), -5.0f), vec3(0.2f, 0.22f, 0.2f), 0.0f, vec3(1.0f));
+	wizardTransform = modelMatrix(vec3(-7.0f, terrain.getHeight(-7.0f, 3.0f) + 0.55f, 3.0f), vec3(0.005f, 0.005f, 0.005f), 0.0f, vec3(1.0f));
+}
+
+vector<mat4> createTreeTransforms(const Terrain& terrain) {
+	//each tree stands on the terrain below it, it's too big for our scene, so scale it down
+	auto plant = [&terrain](float x, float z, float angle) {
+		mat4 tree = translate(mat4(1.0f), vec3(x, terrain.getHeight(x, z), z));
+		tree = scale(tree, vec3(0.05f, 0.05f, 0.05f));
+		return rotate(tree, radians(angle), vec3(0, 1.0f, 0.0f));
+	};
+
+	vector<mat4> trees;
+	trees.push_back(plant(0.0f, -3.0f, 0.0f));
+	for (unsigned int i = 0; i < 30; i++)
+		trees.push_back(plant(0.05f * 909.0f * sin(i), 0.05f * 410.0f * sin(i * 4.2f), 20.0f * (i + 1)));
+	for (unsigned int i = 0; i < 30; i++)
+		trees.push_back(plant(0.05f * 1209.0f * sin(i), 0.05f * 1200.0f * sin(i * 2.5f), 20.0f * (i + 1)));
+	for (unsigned int i = 0; i < 30; i++)
+		trees.push_back(plant(0.05f * 1509.0f * sin(i), 0.05f * 2000.0f * sin(i * 6.0f), 20.0f * (i + 1)));
+	return trees;
+}
 
+vector<vec3> createLampPositions(int count, const Terrain& terrain) {
+	//scattered around the house and the wizard, a few units above the ground
+	vector<vec3> lamps;
+	for (int i = 0; i < count; i++) {
+		float x = 60.0f * sin(i * 1.7f), z = 60.0f * sin(i * 3.1f + 1.0f);
+		lamps.push_back(vec3(x, terrain.getHeight(x, z) + 2.25f + 2.0f * fract(sin(i * 12.9898f) * 43758.5453f), z));
+	}
+	return lamps;
+}
 
-	for (unsigned int i = 0; i < 30; i++) {
-		mat4 treeLoop = scale(mat4(1.0f), vec3(0.05f, 0.05f, 0.05f));
-		treeLoop = translate(treeLoop, vec3(909.0f * sin(i), -15.0f, 410.0f * sin(i * 4.2)));
-		treeLoop = rotate(treeLoop, radians(20.0f * (i + 1)), vec3(0, 1.0f, 0.0f));
-		shader.setMat4("modelMatrix", 1, GL_FALSE, treeLoop);
-		treeModel.draw(shader);
+void renderTrees(RenderQueue& queue, ShaderVariants& shader, Model& treeModel, const uint8_t* visibility) {
+	queue.submitInstanced(shader, treeModel, 0, visibility);
+}
+
+void updateSceneBounds(Model& houseModel, Model& wizardModel, Model& treeModel) {
+	sceneProxies.resize(SCENE_TREES + treeModel.getInstanceCount(), -1);
+
+	//objects get their leaf once their model is uploaded and its bounds are known
+	if (houseModel.isReady() && sceneProxies[SCENE_HOUSE] < 0) addSceneObject(SCENE_HOUSE, houseModel, houseTransform);
+	if (treeModel.isReady() && treeModel.getInstanceCount() > 0 && sceneProxies[SCENE_TREES] < 0) {
+		for (GLsizei i = 0; i < treeModel.getInstanceCount(); i++)
+			addSceneObject(SCENE_TREES + i, treeModel, treeModel.getInstances()[i]);
+	}
+
+	//the wizard could walk around, his leaf only changes places in the tree once he leaves its margin
+	if (wizardModel.isReady()) {
+		if (sceneProxies[SCENE_WIZARD] < 0) {
+			addSceneObject(SCENE_WIZARD, wizardModel, wizardTransform);
+		} else {
+			vec3 minimum, maximum;
+			wizardModel.getBounds(minimum, maximum);
+			transformBounds(wizardTransform, minimum, maximum);
+			sceneTree.move(sceneProxies[SCENE_WIZARD], minimum, maximum);
+		}
 	}
-	for (unsigned int i = 0; i < 30; i++) {
-		mat4 treeLoop = scale(mat4(1.0f), vec3(0.05f, 0.05f, 0.05f));
-		treeLoop = translate(treeLoop, vec3(1209.0f * sin(i), -15.0f, 1200.0f * sin(i * 2.5)));
-		treeLoop = rotate(treeLoop, radians(20.0f * (i + 1)), vec3(0, 1.0f, 0.0f));
-		shader.setMat4("modelMatrix", 1, GL_FALSE, treeLoop);
-		treeModel.draw(shader);
+}
+
+void addSceneObject(uint32_t object, Model& model, const mat4& transform) {
+	vec3 minimum, maximum;
+	model.getBounds(minimum, maximum);
+	transformBounds(transform, minimum, maximum);
+	sceneProxies[object] = sceneTree.insert(minimum, maximum, object);
+}
+
+void cullScene(Model& houseModel, Model& wizardModel, Model& treeModel, OcclusionCuller* culler) {
+	sceneVisibility.assign(sceneProxies.size(), 0);
+
+	//the frustum query only walks the tree around the view, so only objects in view reach the occlusion test
+	visibleObjects.clear();
+	sceneTree.query(viewFrustum, visibleObjects);
+	for (uint32_t object : visibleObjects) {
+		Model& model = object == SCENE_HOUSE ? houseModel : object == SCENE_WIZARD ? wizardModel : treeModel;
+		const mat4& transform = object == SCENE_HOUSE ? houseTransform : object == SCENE_WIZARD ? wizardTransform : treeModel.getInstances()[object - SCENE_TREES];
+		vec3 minimum, maximum;
+		model.getBounds(minimum, maximum);
+		sceneVisibility[object] = !culler || culler->isVisible(transform, minimum, maximum);
 	}
-	for (unsigned int i = 0; i < 30; i++) {
-		mat4 treeLoop = scale(mat4(1.0f), vec3(0.05f, 0.05f, 0.05f));
-		treeLoop = translate(treeLoop, vec3(1509.0f * sin(i), -15.0f, 2000.0f * sin(i * 6)));
-		treeLoop = rotate(treeLoop, radians(20.0f * (i + 1)), vec3(0, 1.0f, 0.0f));
-		shader.setMat4("modelMatrix", 1, GL_FALSE, treeLoop);
-		treeModel.draw(shader);
+}
+
+void updateOccluders(OcclusionCuller& culler, Terrain& terrain, Model& houseModel) {
+	culler.begin(viewProjection);
+
+	terrainOccluders.clear();
+	terrain.getOccluders(cam.camPosition, occlusionSettings.terrainDistance, occlusionSettings.terrainLevel, terrainOccluders);
+	culler.addTriangles(terrainOccluders);
+
+	//walls and roof are thin and open at windows and doors, a box well inside the model stands in for them
+	if (houseModel.isReady()) {
+		vec3 minimum, maximum;
+		houseModel.getBounds(minimum, maximum);
+		culler.addBox(houseTransform, mix(minimum, maximum, vec3(0.2f, 0.0f, 0.2f)), mix(minimum, maximum, vec3(0.8f, 0.6f, 0.8f)));
 	}
 }
 
-void renderCollisionShape(Geometry& collisionShape, Shader& collisionShader, vec3 translation, vec3 scaling, float rotationAngle, vec3 rotationAxis) {
+void renderShadowCasters(RenderQueue& queue, ShaderVariants& shadowShader, const mat4& lightMatrix, const function<void(ShaderVariants&)>& submit) {
+	Shader& shader = shadowShader.get(0);
+	shader.use();
+	shader.setMat4("lightMatrix", 1, GL_FALSE, lightMatrix);
+	submit(shadowShader);
+	queue.execute(cam.camPosition);
+}
+
+void renderCollisionShape(Geometry& collisionShape, Shader& collisionShader, mat4 bodyMatrix, vec3 translation, vec3 scaling, float rotationAngle, vec3 rotationAxis) {
 	glEnable(GL_BLEND);
-	mat4 collisionShapeModel = translate(mat4(1.0f), translation);
+	mat4 collisionShapeModel = translate(bodyMatrix, translation);		//bodyMatrix is the interpolated physics transform
 	collisionShapeModel = scale(collisionShapeModel, scaling);
 	collisionShapeModel = rotate(collisionShapeModel, radians(rotationAngle), rotationAxis);
 	collisionShader.use();
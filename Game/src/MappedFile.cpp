@@ -0,0 +1,76 @@
+#include "MappedFile.h"
+#include <algorithm>
+
+#ifdef _WIN32
+#include <Windows.h>
+
+MappedFile::MappedFile(const string& path)
+	: data(nullptr), size(0), file(INVALID_HANDLE_VALUE), mapping(NULL)
+{
+	file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) return;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) return;
+
+	mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL) return;
+
+	data = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (data) size = size_t(fileSize.QuadPart);
+}
+
+void MappedFile::prefetch(size_t offset, size_t length) const
+{
+	if (!data || offset >= size) return;
+	WIN32_MEMORY_RANGE_ENTRY range;
+	range.VirtualAddress = const_cast<unsigned char*>(data + offset);
+	range.NumberOfBytes = length < size - offset ? length : size - offset;		//Windows.h defines min as a macro
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+
+MappedFile::~MappedFile()
+{
+	if (data) UnmapViewOfFile(data);
+	if (mapping != NULL) CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+}
+
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+MappedFile::MappedFile(const string& path)
+	: data(nullptr), size(0), file(-1)
+{
+	file = open(path.c_str(), O_RDONLY);
+	if (file < 0) return;
+
+	struct stat info;
+	if (fstat(file, &info) != 0 || info.st_size == 0) return;
+
+	void* view = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+	if (view == MAP_FAILED) return;
+	data = static_cast<const unsigned char*>(view);
+	size = size_t(info.st_size);
+}
+
+void MappedFile::prefetch(size_t offset, size_t length) const
+{
+	if (!data || offset >= size) return;
+	//madvise wants a page aligned start
+	size_t page = size_t(sysconf(_SC_PAGESIZE));
+	size_t start = offset / page * page;
+	size_t end = std::min(offset + length, size);
+	madvise(const_cast<unsigned char*>(data + start), end - start, MADV_WILLNEED);
+}
+
+MappedFile::~MappedFile()
+{
+	if (data) munmap(const_cast<unsigned char*>(data), size);
+	if (file >= 0) close(file);
+}
+
+#endif
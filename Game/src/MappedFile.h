@@ -0,0 +1,34 @@
+#pragma once
+#include <string>
+#include <cstddef>
+
+using namespace std;
+
+//Read-only view of a whole file mapped into memory, unmapped on destruction
+class MappedFile
+{
+public:
+	MappedFile(const string& path);
+	~MappedFile();
+
+	bool isOpen() const { return data != nullptr; }
+	const unsigned char* getData() const { return data; }
+	size_t getSize() const { return size; }
+
+	//asks the OS to start reading the pages of [offset, offset + length) so later accesses don't
+	//fault on disk, a hint that returns before the data is there
+	void prefetch(size_t offset, size_t length) const;
+
+private:
+	const unsigned char* data;
+	size_t size;
+#ifdef _WIN32
+	void* file;
+	void* mapping;
+#else
+	int file;
+#endif
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+};
@@ -1,63 +1,49 @@
 #include "Mesh.h"
+#include "GeometryArena.h"
 
-Mesh::Mesh(vector<MeshVertex> vertices, vector<unsigned int> indices, vector<MeshTexture> textures)
+Mesh::Mesh(const MeshVertex* vertices, size_t vertexCount, const void* indices, GLenum indexType, size_t indexCount, vector<MeshTexture> textures, vector<MeshLod> lods)
 {
-    this->vertices = vertices;
-    this->indices  = indices;
     this->textures = textures;
+    this->lods = lods;
+    if (this->lods.empty()) this->lods.push_back({ 0, GLuint(indexCount), 0.0f });
 
-    setupMesh();
-}
-
-void Mesh::draw(Shader shader)
-{
-    GLuint diffuseNr = 1;
-    GLuint specularNr = 1;
-    for (unsigned int i = 0; i < textures.size(); i++)
+    // bounds for culling and LOD selection, the vertices are gone after upload
+    vec3 minimum(0.0f), maximum(0.0f);
+    if (vertexCount > 0) minimum = maximum = vertices[0].position;
+    for (size_t i = 1; i < vertexCount; i++)
     {
-        glActiveTexture(GL_TEXTURE0 + i); // activate proper texture unit before binding
-        // retrieve texture number (the N in diffuse_textureN)
-        string number;
-        string name = textures[i].type;
-        if (name == "texture_diffuse")
-            number = std::to_string(diffuseNr++);
-        else if (name == "texture_specular")
-            number = std::to_string(specularNr++);
-
-        shader.setFloat(("material." + name + number).c_str(), i);
-        glBindTexture(GL_TEXTURE_2D, textures[i].id);
+        minimum = glm::min(minimum, vertices[i].position);
+        maximum = glm::max(maximum, vertices[i].position);
+    }
+    boundsMin = minimum;
+    boundsMax = maximum;
+    boundsCenter = (minimum + maximum) * 0.5f;
+    boundsRadius = length(maximum - minimum) * 0.5f;
+
+    // the first diffuse and specular texture are the material, they pick the shader variant
+    diffuseMap = specularMap = -1;
+    for (int i = 0; i < int(textures.size()); i++)
+    {
+        if (textures[i].type == "texture_diffuse" && diffuseMap < 0) diffuseMap = i;
+        else if (textures[i].type == "texture_specular" && specularMap < 0) specularMap = i;
     }
-    glActiveTexture(GL_TEXTURE0);
 
-    // draw mesh
-    glBindVertexArray(vao);
-    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
+    setupMesh(vertices, vertexCount, indices, indexType, indexCount);
 }
 
-void Mesh::setupMesh()
+void Mesh::bindTextures()
 {
-    glGenVertexArrays(1, &vao);
-    glGenBuffers(1, &vbo);
-    glGenBuffers(1, &ebo);
-
-    glBindVertexArray(vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(MeshVertex), &vertices[0], GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-    // vertex positions
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)0);
-    // vertex normals
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)offsetof(MeshVertex, normal));
-    // vertex texture coordinates
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)offsetof(MeshVertex, textureCoords));
+    // units match the sampler bindings in fragment.frag, textures the variant doesn't sample aren't bound
+    if (diffuseMap >= 0) glBindTextureUnit(0, textures[diffuseMap].id);
+    if (specularMap >= 0) glBindTextureUnit(1, textures[specularMap].id);
+}
 
-    glBindVertexArray(0);
+void Mesh::setupMesh(const MeshVertex* vertices, size_t vertexCount, const void* indices, GLenum indexType, size_t indexCount)
+{
+    // vertices and indices go into the shared arena buffers, drawn through its VAO
+    ArenaRange range = GeometryArena::get().allocate(vertices, vertexCount, indices, indexType, indexCount);
+    baseVertex = range.baseVertex;
+    firstIndex = range.firstIndex;
+    indexCount = range.indexCount;
+    this->indexType = range.indexType;
 }
@@ -7,7 +7,7 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
-#include "Shader.h"
+#include "ShaderVariants.h"
 
 using namespace glm;
 using namespace std;
@@ -18,6 +18,13 @@ struct MeshVertex {
     vec2 textureCoords;
 };
 
+//one level of detail: a range of the mesh's indices over the shared vertices
+struct MeshLod {
+    GLuint firstIndex;      // relative to the mesh's first index
+    GLuint indexCount;
+    float error;            // largest distance from the full mesh surface, object space units
+};
+
 struct MeshTexture {
     GLuint id;
     string type;
@@ -27,18 +34,45 @@ struct MeshTexture {
 
 class Mesh {
 public:
-    vector<MeshVertex>  vertices;
-    vector<GLuint>  indices;
     vector<MeshTexture> textures;
     
 
-    Mesh(vector<MeshVertex> vertices, vector<unsigned int> indices, vector<MeshTexture> textures);
+    //vertices and indices (GL_UNSIGNED_SHORT or GL_UNSIGNED_INT) are copied straight into the GeometryArena, the mesh keeps no CPU copy
+    //lods index into indices, an empty list draws all of them as a single level
+    Mesh(const MeshVertex* vertices, size_t vertexCount, const void* indices, GLenum indexType, size_t indexCount, vector<MeshTexture> textures, vector<MeshLod> lods = {});
+
+    //binds the diffuse and specular map to the units the shader variants sample them from
+    void bindTextures();
+    GLuint getTextureKey() const { return textures.empty() ? 0 : textures[0].id; }
+    //ShaderFeature bits for the maps this mesh has
+    unsigned int getShaderFeatures() const { return (diffuseMap >= 0 ? unsigned(SHADER_DIFFUSE_MAP) : 0u) | (specularMap >= 0 ? unsigned(SHADER_SPECULAR_MAP) : 0u); }
+
+    //where the mesh lives in the arena buffers, for building draw commands
+    GLint getBaseVertex() const { return baseVertex; }
+    GLuint getFirstIndex() const { return firstIndex; }
+    GLuint getIndexCount() const { return indexCount; }
+    GLenum getIndexType() const { return indexType; }
+
+    //level 0 is the full mesh, each following level is coarser
+    size_t getLodCount() const { return lods.size(); }
+    const MeshLod& getLod(size_t i) const { return lods[i]; }
 
-    void draw(Shader shader);
+    //bounding sphere in object space, around the center of the bounding box
+    vec3 getBoundsCenter() const { return boundsCenter; }
+    float getBoundsRadius() const { return boundsRadius; }
+    //axis aligned bounding box in object space
+    vec3 getBoundsMin() const { return boundsMin; }
+    vec3 getBoundsMax() const { return boundsMax; }
 
 
 private:
-    unsigned int vao, vbo, ebo;
+    GLint baseVertex;
+    GLuint firstIndex, indexCount;
+    GLenum indexType;
+    vector<MeshLod> lods;
+    vec3 boundsCenter, boundsMin, boundsMax;
+    float boundsRadius;
+    int diffuseMap, specularMap;    // index into textures, -1 if the mesh has none (ids change when textures finish loading)
     
-    void setupMesh();
+    void setupMesh(const MeshVertex* vertices, size_t vertexCount, const void* indices, GLenum indexType, size_t indexCount);
 };
\ No newline at end of file
@@ -0,0 +1,329 @@
+#include "MeshOptimizer.h"
+#include "Hash.h"
+
+void optimizeMesh(MeshData& mesh)
+{
+	if (mesh.indices.empty()) return;
+
+	weldVertices(mesh.vertices, mesh.indices);
+
+	vector<float> errors;
+	vector<vector<GLuint>> lods = generateLods(mesh.vertices, mesh.indices, errors);
+	optimizeVertexCache(mesh.indices, mesh.vertices.size());
+	optimizeOverdraw(mesh.indices, mesh.vertices);
+
+	//the levels follow the full mesh in one index list, each cache optimized on its own
+	mesh.lods.clear();
+	mesh.lods.push_back({ 0, GLuint(mesh.indices.size()), 0.0f });
+	for (size_t i = 0; i < lods.size(); i++) {
+		optimizeVertexCache(lods[i], mesh.vertices.size());
+		mesh.lods.push_back({ GLuint(mesh.indices.size()), GLuint(lods[i].size()), errors[i] });
+		mesh.indices.insert(mesh.indices.end(), lods[i].begin(), lods[i].end());
+	}
+	optimizeVertexFetch(mesh.vertices, mesh.indices);
+
+	//every index fits into 16 bits, halves the index buffer and its bandwidth
+	if (mesh.vertices.size() <= 0x10000) {
+		mesh.shortIndices.assign(mesh.indices.begin(), mesh.indices.end());
+		mesh.indices.clear();
+	}
+}
+
+
+//------------------------Welding------------------------------------
+struct VertexHash {
+	size_t operator()(const MeshVertex& v) const { return size_t(hashBytes(&v, sizeof(MeshVertex))); }
+};
+
+struct VertexEqual {
+	bool operator()(const MeshVertex& a, const MeshVertex& b) const { return memcmp(&a, &b, sizeof(MeshVertex)) == 0; }
+};
+
+void weldVertices(vector<MeshVertex>& vertices, vector<GLuint>& indices)
+{
+	unordered_map<MeshVertex, GLuint, VertexHash, VertexEqual> unique;
+	unique.reserve(vertices.size());
+	vector<GLuint> remap(vertices.size());
+	vector<MeshVertex> welded;
+
+	for (size_t i = 0; i < vertices.size(); i++) {
+		auto inserted = unique.insert(make_pair(vertices[i], GLuint(welded.size())));
+		if (inserted.second) welded.push_back(vertices[i]);
+		remap[i] = inserted.first->second;
+	}
+
+	//triangles that lost their area by welding draw nothing, drop them
+	vector<GLuint> result;
+	result.reserve(indices.size());
+	for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+		GLuint a = remap[indices[t]], b = remap[indices[t + 1]], c = remap[indices[t + 2]];
+		if (a == b || b == c || a == c) continue;
+		result.push_back(a);
+		result.push_back(b);
+		result.push_back(c);
+	}
+	indices.swap(result);
+	vertices.swap(welded);
+}
+
+
+//------------------------LOD chain------------------------------------
+const float LOD_REDUCTION = 0.5f;		//triangles kept per level relative to the level before
+const float LOD_MIN_GAIN = 0.8f;		//a level that keeps more than this isn't worth its indices
+
+vector<vector<GLuint>> generateLods(const vector<MeshVertex>& vertices, const vector<GLuint>& indices, vector<float>& errors, size_t maxLods, float maxErrorRatio)
+{
+	vector<vector<GLuint>> lods;
+	errors.clear();
+	if (vertices.empty()) return lods;
+
+	vec3 minimum = vertices[0].position, maximum = vertices[0].position;
+	for (const MeshVertex& v : vertices) {
+		minimum = glm::min(minimum, v.position);
+		maximum = glm::max(maximum, v.position);
+	}
+	float maxError = length(maximum - minimum) * maxErrorRatio;
+
+	//every level starts from the full mesh so its error is measured against the original surface
+	size_t previous = indices.size();
+	while (lods.size() < maxLods) {
+		size_t target = size_t(previous / 3 * LOD_REDUCTION) * 3;
+		float error;
+		vector<GLuint> lod = simplifyMesh(vertices, indices, target, maxError, error);
+		if (lod.empty() || lod.size() > previous * LOD_MIN_GAIN) break;
+
+		previous = lod.size();
+		lods.push_back(lod);
+		errors.push_back(error);
+	}
+	return lods;
+}
+
+
+//------------------------Vertex cache (Forsyth)------------------------------------
+const int FORSYTH_CACHE_SIZE = 32;
+const float FORSYTH_CACHE_DECAY_POWER = 1.5f;
+const float FORSYTH_LAST_TRI_SCORE = 0.75f;
+const float FORSYTH_VALENCE_BOOST_SCALE = 2.0f;
+const float FORSYTH_VALENCE_BOOST_POWER = 0.5f;
+
+static float forsythScore(int cachePosition, int remainingTriangles)
+{
+	if (remainingTriangles == 0) return -1.0f;		//no triangles left, never picked again
+
+	float score = 0.0f;
+	if (cachePosition >= 0) {
+		if (cachePosition < 3) {
+			//used by the last triangle, a fixed score so the strip isn't continued blindly
+			score = FORSYTH_LAST_TRI_SCORE;
+		} else {
+			float scaler = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+			score = pow(1.0f - (cachePosition - 3) * scaler, FORSYTH_CACHE_DECAY_POWER);
+		}
+	}
+
+	//prefer vertices with few triangles left, finishes them off before they leave the cache
+	score += FORSYTH_VALENCE_BOOST_SCALE * pow(float(remainingTriangles), -FORSYTH_VALENCE_BOOST_POWER);
+	return score;
+}
+
+void optimizeVertexCache(vector<GLuint>& indices, size_t vertexCount)
+{
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0) return;
+
+	//triangles adjacent to every vertex
+	vector<int> remaining(vertexCount, 0), offsets(vertexCount + 1, 0);
+	for (GLuint index : indices) remaining[index]++;
+	for (size_t v = 0; v < vertexCount; v++) offsets[v + 1] = offsets[v] + remaining[v];
+	vector<int> adjacency(indices.size()), fill(offsets.begin(), offsets.end() - 1);
+	for (size_t t = 0; t < triangleCount; t++)
+		for (int k = 0; k < 3; k++) adjacency[fill[indices[t * 3 + k]]++] = int(t);
+
+	vector<int> cachePosition(vertexCount, -1);
+	vector<float> vertexScore(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++) vertexScore[v] = forsythScore(-1, remaining[v]);
+
+	vector<float> triangleScore(triangleCount);
+	vector<bool> emitted(triangleCount, false);
+	for (size_t t = 0; t < triangleCount; t++)
+		triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+
+	vector<GLuint> result;
+	result.reserve(indices.size());
+	vector<int> cache, newCache;
+	int best = int(max_element(triangleScore.begin(), triangleScore.end()) - triangleScore.begin());
+	size_t scanStart = 0;
+
+	while (best >= 0) {
+		emitted[best] = true;
+		for (int k = 0; k < 3; k++) {
+			GLuint v = indices[best * 3 + k];
+			result.push_back(v);
+			remaining[v]--;
+
+			//move the triangle to the end of the vertex' list so the first remaining[v] entries stay live
+			int* first = &adjacency[offsets[v]];
+			int* last = first + remaining[v] + 1;
+			int* it = find(first, last, best);
+			swap(*it, *(last - 1));
+		}
+
+		//emitted vertices go to the front of the LRU cache
+		newCache.clear();
+		for (int k = 0; k < 3; k++) newCache.push_back(int(indices[best * 3 + k]));
+		for (int v : cache)
+			if (v != newCache[0] && v != newCache[1] && v != newCache[2]) newCache.push_back(v);
+
+		for (size_t i = 0; i < newCache.size(); i++) {
+			int v = newCache[i];
+			cachePosition[v] = i < size_t(FORSYTH_CACHE_SIZE) ? int(i) : -1;
+			vertexScore[v] = forsythScore(cachePosition[v], remaining[v]);
+		}
+		if (newCache.size() > size_t(FORSYTH_CACHE_SIZE)) newCache.resize(FORSYTH_CACHE_SIZE);
+		cache.swap(newCache);
+
+		//only triangles touching the cache changed their score
+		best = -1;
+		float bestScore = -1.0f;
+		for (int v : cache) {
+			for (int i = 0; i < remaining[v]; i++) {
+				int t = adjacency[offsets[v] + i];
+				float score = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+				triangleScore[t] = score;
+				if (score > bestScore) {
+					bestScore = score;
+					best = t;
+				}
+			}
+		}
+
+		//cache ran dry, continue with the next triangle not emitted yet
+		if (best < 0) {
+			while (scanStart < triangleCount && emitted[scanStart]) scanStart++;
+			if (scanStart < triangleCount) best = int(scanStart);
+		}
+	}
+
+	indices.swap(result);
+}
+
+
+//------------------------Overdraw------------------------------------
+//FIFO cache simulation, returns the misses of triangles [first, last) starting from an empty cache
+static int countMisses(const vector<GLuint>& indices, size_t first, size_t last, vector<int>& timestamps, int& time, int cacheSize)
+{
+	int misses = 0;
+	for (size_t t = first; t < last; t++) {
+		for (int k = 0; k < 3; k++) {
+			GLuint v = indices[t * 3 + k];
+			if (time - timestamps[v] > cacheSize) {
+				timestamps[v] = time++;
+				misses++;
+			}
+		}
+	}
+	return misses;
+}
+
+void optimizeOverdraw(vector<GLuint>& indices, const vector<MeshVertex>& vertices, float threshold)
+{
+	const int cacheSize = 16;
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount < 2) return;
+
+	//advancing time past the cache size empties the simulated cache
+	vector<int> timestamps(vertices.size(), -cacheSize - 1);
+	int time = 0;
+
+	//hard boundaries: triangles where the cache order starts over (all three vertices miss)
+	vector<size_t> hard;
+	for (size_t t = 0; t < triangleCount; t++)
+		if (countMisses(indices, t, t + 1, timestamps, time, cacheSize) == 3) hard.push_back(t);
+	hard.push_back(triangleCount);
+
+	//soft boundaries: split a hard cluster wherever its ACMR so far is close enough to the whole cluster's
+	vector<size_t> clusters;
+	for (size_t h = 0; h + 1 < hard.size(); h++) {
+		size_t start = hard[h], end = hard[h + 1];
+		time += cacheSize + 1;
+		float clusterRatio = countMisses(indices, start, end, timestamps, time, cacheSize) / float(end - start);
+
+		clusters.push_back(start);
+		time += cacheSize + 1;
+		int misses = 0;
+		for (size_t t = start; t < end; t++) {
+			misses += countMisses(indices, t, t + 1, timestamps, time, cacheSize);
+			if (t + 1 < end && misses / float(t + 1 - clusters.back()) <= clusterRatio * threshold && t + 1 - clusters.back() >= 16) {
+				clusters.push_back(t + 1);
+				time += cacheSize + 1;
+				misses = 0;
+			}
+		}
+	}
+	clusters.push_back(triangleCount);
+
+	//area weighted centroid and normal of the mesh and of every cluster
+	vec3 meshCentroid(0.0f);
+	float meshArea = 0.0f;
+	vector<vec3> centroids, normals;
+	for (size_t c = 0; c + 1 < clusters.size(); c++) {
+		vec3 centroid(0.0f), normal(0.0f);
+		float area = 0.0f;
+		for (size_t t = clusters[c]; t < clusters[c + 1]; t++) {
+			vec3 a = vertices[indices[t * 3]].position, b = vertices[indices[t * 3 + 1]].position, d = vertices[indices[t * 3 + 2]].position;
+			vec3 n = cross(b - a, d - a);
+			float triangleArea = length(n);
+			centroid += (a + b + d) / 3.0f * triangleArea;
+			normal += n;
+			area += triangleArea;
+		}
+		meshCentroid += centroid;
+		meshArea += area;
+		centroids.push_back(area > 0.0f ? centroid / area : centroid);
+		normals.push_back(length(normal) > 0.0f ? normalize(normal) : normal);
+	}
+	if (meshArea > 0.0f) meshCentroid /= meshArea;
+
+	//clusters on the outside facing away from the center occlude the rest, draw them first
+	vector<size_t> order(clusters.size() - 1);
+	vector<float> keys(order.size());
+	for (size_t c = 0; c < order.size(); c++) {
+		order[c] = c;
+		keys[c] = dot(centroids[c] - meshCentroid, normals[c]);
+	}
+	stable_sort(order.begin(), order.end(), [&keys](size_t a, size_t b) { return keys[a] > keys[b]; });
+
+	vector<GLuint> result;
+	result.reserve(indices.size());
+	for (size_t c : order)
+		result.insert(result.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+	indices.swap(result);
+}
+
+
+//------------------------Vertex fetch------------------------------------
+void optimizeVertexFetch(vector<MeshVertex>& vertices, vector<GLuint>& indices)
+{
+	const GLuint unused = ~0u;
+	vector<GLuint> remap(vertices.size(), unused);
+	vector<MeshVertex> ordered;
+	ordered.reserve(vertices.size());
+
+	for (GLuint& index : indices) {
+		if (remap[index] == unused) {
+			remap[index] = GLuint(ordered.size());
+			ordered.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+	vertices.swap(ordered);
+}
+
+float vertexCacheMissRatio(const vector<GLuint>& indices, size_t vertexCount, int cacheSize)
+{
+	if (indices.size() < 3) return 0.0f;
+	vector<int> timestamps(vertexCount, -cacheSize - 1);
+	int time = 0;
+	return countMisses(indices, 0, indices.size() / 3, timestamps, time, cacheSize) / float(indices.size() / 3);
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "Model.h"
+#include "MeshSimplifier.h"
+
+using namespace glm;
+using namespace std;
+
+//Import time optimization of a parsed mesh, runs once before the model is cooked:
+//welds identical vertices, simplifies the mesh into a chain of LODs, orders triangles for the
+//post-transform vertex cache and then for overdraw, orders vertices by first use and narrows
+//indices to 16 bits if they fit.
+void optimizeMesh(MeshData& mesh);
+
+//coarser levels of detail over the same vertices, each with about half the triangles of the
+//level before, until the error grows beyond maxErrorRatio of the mesh size
+vector<vector<GLuint>> generateLods(const vector<MeshVertex>& vertices, const vector<GLuint>& indices, vector<float>& errors, size_t maxLods = 4, float maxErrorRatio = 0.1f);
+
+//merges bitwise identical vertices, remaps the indices and drops triangles that became degenerate
+void weldVertices(vector<MeshVertex>& vertices, vector<GLuint>& indices);
+
+//Tom Forsyth's linear-speed vertex cache optimization, reorders triangles only (no degenerate ones)
+void optimizeVertexCache(vector<GLuint>& indices, size_t vertexCount);
+
+//splits the cache optimized order into clusters and draws clusters facing outwards first;
+//threshold is how much worse than the cluster's own ACMR a split point may be
+void optimizeOverdraw(vector<GLuint>& indices, const vector<MeshVertex>& vertices, float threshold = 1.05f);
+
+//renumbers vertices in the order the indices first use them, drops unused vertices
+void optimizeVertexFetch(vector<MeshVertex>& vertices, vector<GLuint>& indices);
+
+//average cache miss ratio (vertex shader runs per triangle) for a FIFO cache
+float vertexCacheMissRatio(const vector<GLuint>& indices, size_t vertexCount, int cacheSize = 16);
@@ -0,0 +1,235 @@
+#include "MeshSimplifier.h"
+#include "Hash.h"
+
+//symmetric 4x4 matrix of the plane equations around a vertex, upper triangle only
+struct Quadric {
+	float a00, a01, a02, a03;
+	float a11, a12, a13;
+	float a22, a23;
+	float a33;
+
+	Quadric() : a00(0), a01(0), a02(0), a03(0), a11(0), a12(0), a13(0), a22(0), a23(0), a33(0) {}
+
+	//plane n.x + d = 0
+	Quadric(vec3 n, float d)
+		: a00(n.x * n.x), a01(n.x * n.y), a02(n.x * n.z), a03(n.x * d),
+		a11(n.y * n.y), a12(n.y * n.z), a13(n.y * d),
+		a22(n.z * n.z), a23(n.z * d),
+		a33(d * d) {}
+
+	Quadric& operator+=(const Quadric& q)
+	{
+		a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+		a11 += q.a11; a12 += q.a12; a13 += q.a13;
+		a22 += q.a22; a23 += q.a23;
+		a33 += q.a33;
+		return *this;
+	}
+
+	//sum of squared distances of p to the planes
+	float evaluate(vec3 p) const
+	{
+		return a00 * p.x * p.x + 2 * a01 * p.x * p.y + 2 * a02 * p.x * p.z + 2 * a03 * p.x
+			+ a11 * p.y * p.y + 2 * a12 * p.y * p.z + 2 * a13 * p.y
+			+ a22 * p.z * p.z + 2 * a23 * p.z
+			+ a33;
+	}
+};
+
+struct Collapse {
+	GLuint from, to;		//positions
+	float cost;
+};
+
+struct PositionHash {
+	size_t operator()(const vec3& p) const { return size_t(hashBytes(&p, sizeof(vec3))); }
+};
+
+static uint64_t edgeKey(GLuint a, GLuint b)
+{
+	return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+}
+
+//the corner of triangle t at position p, -1 if it has none
+static int cornerAt(const vector<GLuint>& indices, const vector<GLuint>& positionOf, size_t t, GLuint p)
+{
+	for (int k = 0; k < 3; k++)
+		if (positionOf[indices[t * 3 + k]] == p) return k;
+	return -1;
+}
+
+//every copy of from that is still used has to land on the one copy of to it shares an edge with,
+//so texture coordinates and normals stay continuous; copies away from the edge (the collapse
+//would cross a seam or a hard edge) make it invalid. Writes the targets into remap.
+static bool mapCopies(const vector<GLuint>& indices, const vector<GLuint>& positionOf, const vector<GLuint>& triangles, GLuint from, GLuint to, vector<GLuint>& remap, vector<GLuint>& mapped)
+{
+	mapped.clear();
+	for (GLuint t : triangles) {
+		GLuint copy = indices[t * 3 + cornerAt(indices, positionOf, t, from)];
+		int corner = cornerAt(indices, positionOf, t, to);
+		if (std::find(mapped.begin(), mapped.end(), copy) == mapped.end()) {
+			mapped.push_back(copy);
+			remap[copy] = copy;
+		}
+		if (corner < 0) continue;
+		GLuint target = indices[t * 3 + corner];
+		if (remap[copy] != copy && remap[copy] != target) return false;		//two different copies along the edge
+		remap[copy] = target;
+	}
+	for (GLuint copy : mapped)
+		if (remap[copy] == copy) return false;
+	return true;
+}
+
+//true if moving position from onto to flips or collapses a triangle that stays
+static bool flipsTriangle(const vector<vec3>& positions, const vector<GLuint>& indices, const vector<GLuint>& positionOf, const vector<GLuint>& triangles, GLuint from, GLuint to)
+{
+	vec3 target = positions[to];
+	for (GLuint t : triangles) {
+		GLuint a = positionOf[indices[t * 3]], b = positionOf[indices[t * 3 + 1]], c = positionOf[indices[t * 3 + 2]];
+		if (a == to || b == to || c == to) continue;		//this one degenerates and is removed
+
+		vec3 pa = positions[a], pb = positions[b], pc = positions[c];
+		vec3 before = cross(pb - pa, pc - pa);
+		if (a == from) pa = target;
+		if (b == from) pb = target;
+		if (c == from) pc = target;
+		vec3 after = cross(pb - pa, pc - pa);
+		if (dot(before, after) <= 0.0f) return true;
+	}
+	return false;
+}
+
+vector<GLuint> simplifyMesh(const vector<MeshVertex>& vertices, const vector<GLuint>& indices, size_t targetIndexCount, float maxError, float& error)
+{
+	size_t vertexCount = vertices.size();
+	vector<GLuint> result = indices;
+	error = 0.0f;
+
+	//topology works on positions, the vertices at one position (seams, hard edges) are its copies
+	unordered_map<vec3, GLuint, PositionHash> positionIds;
+	vector<GLuint> positionOf(vertexCount);
+	vector<vec3> positions;
+	for (size_t v = 0; v < vertexCount; v++) {
+		auto inserted = positionIds.insert(make_pair(vertices[v].position, GLuint(positions.size())));
+		if (inserted.second) positions.push_back(vertices[v].position);
+		positionOf[v] = inserted.first->second;
+	}
+	size_t positionCount = positions.size();
+
+	//edges used by one triangle are open borders, by more than two the mesh isn't a manifold there
+	unordered_map<uint64_t, int> edgeUse;
+	for (size_t t = 0; t + 2 < result.size(); t += 3)
+		for (int k = 0; k < 3; k++) edgeUse[edgeKey(positionOf[result[t + k]], positionOf[result[t + (k + 1) % 3]])]++;
+
+	vector<Quadric> quadrics(positionCount);
+	vector<int> borderEdges(positionCount, 0);
+	vector<bool> locked(positionCount, false);
+	for (size_t t = 0; t + 2 < result.size(); t += 3) {
+		GLuint p[3] = { positionOf[result[t]], positionOf[result[t + 1]], positionOf[result[t + 2]] };
+		vec3 n = cross(positions[p[1]] - positions[p[0]], positions[p[2]] - positions[p[0]]);
+		if (length(n) == 0.0f) continue;
+		n = normalize(n);
+		Quadric q(n, -dot(n, positions[p[0]]));
+		for (int k = 0; k < 3; k++) quadrics[p[k]] += q;
+
+		for (int k = 0; k < 3; k++) {
+			GLuint a = p[k], b = p[(k + 1) % 3];
+			int use = edgeUse[edgeKey(a, b)];
+			if (use > 2) locked[a] = locked[b] = true;
+			if (use != 1) continue;
+
+			//a plane through the border upright on the triangle keeps the border from moving sideways
+			vec3 side = cross(positions[b] - positions[a], n);
+			if (length(side) == 0.0f) continue;
+			side = normalize(side);
+			Quadric border(side, -dot(side, positions[a]));
+			quadrics[a] += border;
+			quadrics[b] += border;
+			borderEdges[a]++;
+			borderEdges[b]++;
+		}
+	}
+	//a border vertex can only slide along its border, with more than one border through it that's ambiguous
+	for (size_t p = 0; p < positionCount; p++)
+		if (borderEdges[p] > 2) locked[p] = true;
+
+	vector<GLuint> remap(vertexCount), collapseRemap(vertexCount), mapped;
+	vector<bool> touched(positionCount);
+	vector<vector<GLuint>> adjacency(positionCount);
+	vector<Collapse> collapses;
+	vector<float> bestCost(positionCount);
+	vector<GLuint> bestTarget(positionCount);
+	float maxCost = maxError * maxError;
+
+	//passes of independent collapses, cheapest first, until nothing changes
+	while (result.size() > targetIndexCount) {
+		for (auto& list : adjacency) list.clear();
+		for (size_t t = 0; t * 3 < result.size(); t++)
+			for (int k = 0; k < 3; k++) adjacency[positionOf[result[t * 3 + k]]].push_back(GLuint(t));
+
+		//cheapest valid edge for every movable position
+		fill(bestCost.begin(), bestCost.end(), INFINITY);
+		for (size_t t = 0; t + 2 < result.size(); t += 3) {
+			for (int k = 0; k < 3; k++) {
+				for (int side = 1; side <= 2; side++) {
+					GLuint from = positionOf[result[t + k]], to = positionOf[result[t + (k + side) % 3]];
+					if (locked[from] || from == to) continue;
+					Quadric q = quadrics[from];
+					q += quadrics[to];
+					float cost = std::max(q.evaluate(positions[to]), 0.0f);
+					if (cost >= bestCost[from] || cost > maxCost) continue;
+
+					//border vertices only move along an edge that is still a border
+					if (borderEdges[from] > 0) {
+						int shared = 0;
+						for (GLuint other : adjacency[from]) shared += cornerAt(result, positionOf, other, to) >= 0;
+						if (shared != 1) continue;
+					}
+					if (!mapCopies(result, positionOf, adjacency[from], from, to, collapseRemap, mapped)) continue;
+					bestCost[from] = cost;
+					bestTarget[from] = to;
+				}
+			}
+		}
+		collapses.clear();
+		for (size_t p = 0; p < positionCount; p++)
+			if (bestCost[p] <= maxCost) collapses.push_back({ GLuint(p), bestTarget[p], bestCost[p] });
+		if (collapses.empty()) break;
+		sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+		for (size_t v = 0; v < vertexCount; v++) remap[v] = GLuint(v);
+		fill(touched.begin(), touched.end(), false);
+
+		//each collapse removes about two triangles, stop early enough to land near the target
+		size_t removable = (result.size() - targetIndexCount) / 6 + 1;
+		size_t applied = 0;
+		for (const Collapse& c : collapses) {
+			if (applied >= removable) break;
+			if (touched[c.from] || touched[c.to]) continue;
+			if (flipsTriangle(positions, result, positionOf, adjacency[c.from], c.from, c.to)) continue;
+			if (!mapCopies(result, positionOf, adjacency[c.from], c.from, c.to, collapseRemap, mapped)) continue;
+
+			//neighbors keep their position this pass, their quadrics and triangles would be stale
+			for (GLuint t : adjacency[c.from])
+				for (int k = 0; k < 3; k++) touched[positionOf[result[t * 3 + k]]] = true;
+			for (GLuint copy : mapped) remap[copy] = collapseRemap[copy];
+			quadrics[c.to] += quadrics[c.from];
+			error = std::max(error, sqrt(c.cost));
+			applied++;
+		}
+		if (applied == 0) break;
+
+		size_t write = 0;
+		for (size_t t = 0; t + 2 < result.size(); t += 3) {
+			GLuint a = remap[result[t]], b = remap[result[t + 1]], c = remap[result[t + 2]];
+			if (positionOf[a] == positionOf[b] || positionOf[b] == positionOf[c] || positionOf[a] == positionOf[c]) continue;
+			result[write++] = a;
+			result[write++] = b;
+			result[write++] = c;
+		}
+		result.resize(write);
+	}
+
+	return result;
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "Mesh.h"
+
+using namespace glm;
+using namespace std;
+
+//Quadric error edge collapse (Garland & Heckbert) onto existing vertices, so every LOD only
+//needs its own indices and shares the vertex buffer. Collapses work on positions: all vertices
+//at a position (texture seams, hard normal edges) move together, each onto the copy at the other
+//end it shares an edge with, so seams and hard edges only collapse along themselves. Open borders
+//only collapse along the border, non-manifold edges are never moved.
+//Stops once the index count reaches targetIndexCount or the next collapse would move the
+//surface further than maxError (object space); error receives the largest error accepted.
+vector<GLuint> simplifyMesh(const vector<MeshVertex>& vertices, const vector<GLuint>& indices, size_t targetIndexCount, float maxError, float& error);
@@ -1,47 +1,79 @@
 #include "Model.h"
+#include "CookedModel.h"
+#include "Hash.h"
+#include "TextureCache.h"
+#include "DDSTexture.h"
+#include "MeshOptimizer.h"
+
+Model::Model()
+{
+}
 
 Model::Model(char* path)
 {
-	loadModel(path);
+    ModelData data;
+    if (!readModel(path, data)) return;
+
+    for (const string& texturePath : data.texturePaths)
+        addTexture(texturePath, TextureCache::get().acquire(data.directory + '/' + texturePath));
+    for (const MeshData& mesh : data.meshes)
+        addMesh(mesh);
+    setReady();
 }
 
-void Model::draw(Shader shader)
+Model::~Model()
 {
-	for (unsigned int i = 0; i < meshes.size(); i++)
-		meshes[i].draw(shader);
+    for (auto& texture : texturesLoaded)
+        TextureCache::get().release(texture.second);
 }
 
-void Model::loadModel(string path)
+bool Model::readModel(const string& path, ModelData& data)
 {
+    data.directory = path.substr(0, path.find_last_of('/'));
+
+    uint64_t sourceHash = 0;
+    {
+        MappedFile source(path);
+        if (source.isOpen()) sourceHash = hashBytes(source.getData(), source.getSize());
+    }
+    string cookedPath = cookedModelPath(path);
+    if (sourceHash && readCookedModel(cookedPath, sourceHash, data))
+        return true;
+    data.meshes.clear();
+    data.texturePaths.clear();
+
     Assimp::Importer import;
     const aiScene* scene = import.ReadFile(path, aiProcess_Triangulate );
 
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
     {
         cout << "Assimp Error: " << import.GetErrorString() << endl;
-        return;
+        return false;
     }
-    directory = path.substr(0, path.find_last_of('/'));
 
-    processNode(scene->mRootNode, scene);
+    processNode(scene->mRootNode, scene, data);
+    for (MeshData& mesh : data.meshes)
+        optimizeMesh(mesh);     // done once here, the cooked file stores the optimized mesh
+    if (sourceHash) writeCookedModel(cookedPath, sourceHash, data);
+    return true;
 }
 
-void Model::processNode(aiNode* node, const aiScene* scene)
+void Model::processNode(aiNode* node, const aiScene* scene, ModelData& data)
 {
     // process all the node's meshes (if any)
     for (unsigned int i = 0; i < node->mNumMeshes; i++)
     {
         aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-        meshes.push_back(processMesh(mesh, scene));
+        data.meshes.push_back(processMesh(mesh, scene, data));
     }
     // then do the same for each of its children
     for (unsigned int i = 0; i < node->mNumChildren; i++)
     {
-        processNode(node->mChildren[i], scene);
+        processNode(node->mChildren[i], scene, data);
     }
 }
 
-Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene)
+MeshData Model::processMesh(aiMesh* mesh, const aiScene* scene, ModelData& data)
 {
     vector<MeshVertex> vertices;
     vector<GLuint> indices;
@@ -91,90 +123,182 @@ Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene)
     {
         aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
         vector<MeshTexture> diffuseMaps = loadMaterialTextures(material,
-            aiTextureType_DIFFUSE, "texture_diffuse");
+            aiTextureType_DIFFUSE, "texture_diffuse", data);
         textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
         vector<MeshTexture> specularMaps = loadMaterialTextures(material,
-            aiTextureType_SPECULAR, "texture_specular");
+            aiTextureType_SPECULAR, "texture_specular", data);
         textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
     }
 
-    return Mesh(vertices, indices, textures);
+    MeshData meshData;
+    meshData.vertices = vertices;
+    meshData.indices = indices;
+    meshData.textures = textures;
+    return meshData;
 }
 
-vector<MeshTexture> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName)
+vector<MeshTexture> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName, ModelData& data)
 {
-   // cout << "1" << endl;
     vector<MeshTexture> textures;
     for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
     {
-       // cout << "2" << endl;
         aiString str;
         mat->GetTexture(type, i, &str);
-        bool skip = false;
-        for (unsigned int j = 0; j < texturesLoaded.size(); j++)
-        {
-            if (std::strcmp(texturesLoaded[j].path.data(), str.C_Str()) == 0)
-            {
-                textures.push_back(texturesLoaded[j]);
-                skip = true;
-                break;
-            }
-        }
-        if (!skip)
-        {   // if texture hasn't been loaded already, load it
-            MeshTexture texture;
-            texture.id = TextureFromFile(str.C_Str(), directory);
-            texture.type = typeName;
-            texture.path = str.C_Str();
-            textures.push_back(texture);
-            texturesLoaded.push_back(texture); // add to loaded textures
-           // cout << texture.path << ", " << texture.type << endl;
-        }
+
+        // every texture is decoded once per model, meshes only keep the path
+        if (find(data.texturePaths.begin(), data.texturePaths.end(), str.C_Str()) == data.texturePaths.end())
+            data.texturePaths.push_back(str.C_Str());
+
+        MeshTexture texture;
+        texture.id = 0;
+        texture.type = typeName;
+        texture.path = str.C_Str();
+        textures.push_back(texture);
     }
 
-    
     return textures;
 }
 
+void Model::getBounds(vec3& minimum, vec3& maximum) const
+{
+    minimum = maximum = vec3(0.0f);
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        minimum = i == 0 ? meshes[i].getBoundsMin() : glm::min(minimum, meshes[i].getBoundsMin());
+        maximum = i == 0 ? meshes[i].getBoundsMax() : glm::max(maximum, meshes[i].getBoundsMax());
+    }
+}
+
+uint8_t* Model::getLodStates(size_t mesh)
+{
+    size_t stride = std::max<size_t>(1, instances.size());
+    if (lodStates.size() != meshes.size() * stride) lodStates.assign(meshes.size() * stride, 0);
+    return &lodStates[mesh * stride];
+}
+
+void Model::addMesh(const MeshData& data)
+{
+    vector<MeshTexture> textures = data.textures;
+    for (MeshTexture& texture : textures)
+    {
+        auto loaded = texturesLoaded.find(texture.path);
+        texture.id = loaded != texturesLoaded.end() ? loaded->second : placeholderTexture();
+    }
+    meshes.push_back(Mesh(data.getVertices(), data.getVertexCount(), data.getIndices(), data.getIndexType(), data.getIndexCount(), textures, data.lods));
+}
+
+void Model::addTexture(const string& path, GLuint id)
+{
+    auto loaded = texturesLoaded.find(path);
+    if (loaded != texturesLoaded.end())
+    {
+        TextureCache::get().release(loaded->second);
+        loaded->second = id;
+    }
+    else
+        texturesLoaded[path] = id;
+
+    // meshes uploaded before the texture was ready still point at the placeholder
+    for (Mesh& mesh : meshes)
+        for (MeshTexture& meshTexture : mesh.textures)
+            if (meshTexture.path == path) meshTexture.id = id;
+}
+
 
 GLuint TextureFromFile(const char* path, const string& directory)
 {
-    string filename = string(path);
-    filename = directory + '/' + filename;
-    //std::cout << "blabla" << filename << std::endl;
+    return TextureCache::get().acquire(directory + '/' + string(path));
+}
+
+ImageData loadImage(const string& path, const string& directory)
+{
+    ImageData image;
+    image.path = path;
+    string filename = directory + '/' + path;
+
+    // a compressed version made by the TextureConverter replaces the source image
+    string compressed = filename.substr(0, filename.find_last_of('.')) + ".dds";
+    if (readDDS(compressed, image))
+        return image;
 
+    // per thread setting, bottom row first as glTexImage2D expects
+    stbi_set_flip_vertically_on_load_thread(true);
+    image.pixels = stbi_load(filename.c_str(), &image.width, &image.height, &image.components, 0);
+    if (image.pixels)
+    {
+        int size[3] = { image.width, image.height, image.components };
+        image.contentHash = hashBytes(image.pixels, size_t(image.width) * image.height * image.components, hashBytes(size, sizeof(size)));
+    }
+    else
+        std::cout << "Texture failed to load at path: " << path << std::endl;
+
+    return image;
+}
 
+GLuint createTexture(ImageData& image)
+{
     unsigned int textureID;
     glGenTextures(1, &textureID);
 
-    int width, height, nrComponents;
-    unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
+    if (image.compressedFormat)
+    {
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        for (size_t i = 0; i < image.levels.size(); i++)
+        {
+            const ImageLevel& level = image.levels[i];
+            glCompressedTexImage2D(GL_TEXTURE_2D, GLint(i), image.compressedFormat, level.width, level.height, 0, GLsizei(level.size), level.data);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, GLint(image.levels.size()) - 1);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+    else if (image.pixels)
     {
         GLenum format;
-        if (nrComponents == 1)
+        if (image.components == 1)
             format = GL_RED;
-        else if (nrComponents == 3)
+        else if (image.components == 3)
             format = GL_RGB;
-        else if (nrComponents == 4)
+        else if (image.components == 4)
             format = GL_RGBA;
 
         glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);  // rows of RGB images aren't always 4 byte aligned
+        glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.pixels);
         glGenerateMipmap(GL_TEXTURE_2D);
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
     }
-    else
+
+    freeImage(image);
+    return textureID;
+}
+
+void freeImage(ImageData& image)
+{
+    if (image.pixels) stbi_image_free(image.pixels);
+    image.pixels = nullptr;
+    image.levels.clear();
+    image.file.reset();
+}
+
+GLuint placeholderTexture()
+{
+    static GLuint textureID = 0;
+    if (textureID == 0)
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        const unsigned char white[4] = { 255, 255, 255, 255 };
+        glGenTextures(1, &textureID);
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     }
-
     return textureID;
-}
\ No newline at end of file
+}
@@ -4,6 +4,9 @@
 #include <sstream>
 #include <iostream>
 #include <vector>
+#include <algorithm>
+#include <memory>
+#include <unordered_map>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
@@ -13,29 +16,131 @@
 #include "stb_image.h"
 #include "Shader.h"
 #include "Mesh.h"
+#include "MappedFile.h"
 
 using namespace glm;
 using namespace std;
 
 
-GLuint TextureFromFile(const char* path, const string& directory);
+//One mip level of a block compressed image
+struct ImageLevel {
+    int width, height;
+    const unsigned char* data;
+    size_t size;
+};
+
+//CPU side image, decoded on any thread and uploaded later with createTexture
+struct ImageData {
+    string path;            // as referenced by the material, relative to the model directory
+    int width = 0, height = 0, components = 0;
+    unsigned char* pixels = nullptr;
+    uint64_t contentHash = 0;  // hash of size and pixels, lets the TextureCache share identical images
+
+    // block compressed images (.dds) keep all their mip levels in the mapped file instead of pixels
+    GLenum compressedFormat = 0;
+    vector<ImageLevel> levels;
+    shared_ptr<MappedFile> file;
+
+    bool isLoaded() const { return pixels || !levels.empty(); }
+};
+
+//CPU side mesh, textures are referenced by path only (id 0) until they are uploaded
+struct MeshData {
+    vector<MeshVertex> vertices;    // filled when the mesh was parsed by Assimp
+    vector<GLuint> indices;
+    vector<GLushort> shortIndices;  // replaces indices after optimizeMesh if every index fits in 16 bits
+    vector<MeshTexture> textures;
+    vector<MeshLod> lods;           // generated by optimizeMesh, ranges of the indices above
+
+    // set instead when the mesh was read from a cooked file, points into the mapped file
+    const MeshVertex* mappedVertices = nullptr;
+    const void* mappedIndices = nullptr;
+    GLenum mappedIndexType = GL_UNSIGNED_INT;
+    size_t mappedVertexCount = 0, mappedIndexCount = 0;
+
+    const MeshVertex* getVertices() const { return mappedVertices ? mappedVertices : vertices.data(); }
+    size_t getVertexCount() const { return mappedVertices ? mappedVertexCount : vertices.size(); }
+    const void* getIndices() const
+    {
+        if (mappedIndices) return mappedIndices;
+        return shortIndices.empty() ? (const void*)indices.data() : (const void*)shortIndices.data();
+    }
+    GLenum getIndexType() const
+    {
+        if (mappedIndices) return mappedIndexType;
+        return shortIndices.empty() ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+    }
+    size_t getIndexCount() const
+    {
+        if (mappedIndices) return mappedIndexCount;
+        return shortIndices.empty() ? indices.size() : shortIndices.size();
+    }
+    size_t getIndexSize() const { return getIndexType() == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint); }
+};
+
+//Everything parsed from a model file, no GL objects yet
+struct ModelData {
+    string directory;
+    vector<MeshData> meshes;
+    vector<string> texturePaths;    // every texture used by the meshes, once
+    shared_ptr<MappedFile> file;    // cooked file the meshes point into, if any
+};
+
+
+GLuint TextureFromFile(const char* path, const string& directory);   // through the TextureCache, holds a reference
+ImageData loadImage(const string& path, const string& directory);  // thread safe, no GL calls, prefers a .dds next to the file
+GLuint createTexture(ImageData& image);                             // uploads and frees the image data
+void freeImage(ImageData& image);
+GLuint placeholderTexture();                                        // 1x1 white, used until a texture is uploaded
 
 class Model
 {
 public:
-    vector<MeshTexture> texturesLoaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+    unordered_map<string, GLuint> texturesLoaded;	// material texture path -> texture, each holds a TextureCache reference
     vector<Mesh> meshes;
     string directory;
 
 
+    //empty model, filled in by the AssetLoader
+    Model();
+    //loads the model right away on the calling thread
     Model(char* path);
+    ~Model();
+
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
+
+    //reads a model into CPU data, safe to call from any thread
+    //uses the cooked file if it was built from the current source, otherwise parses with Assimp and cooks it
+    static bool readModel(const string& path, ModelData& data);
+
+    //GL thread only: uploads one mesh, its textures that aren't uploaded yet use the placeholder
+    void addMesh(const MeshData& data);
+    //GL thread only: takes over a TextureCache reference and swaps the texture in for the placeholder
+    void addTexture(const string& path, GLuint id);
 
-    void draw(Shader shader);
+    //a model is drawn only once all of its meshes are uploaded
+    bool isReady() const { return ready; }
+    void setReady() { ready = true; }
+
+    //one model matrix per copy, all copies are then drawn with a single draw command per mesh
+    void setInstances(const vector<mat4>& transforms) { instances = transforms; }
+    const vector<mat4>& getInstances() const { return instances; }
+    GLsizei getInstanceCount() const { return GLsizei(instances.size()); }
+
+    //object space box around all meshes, meaningful once the model is ready
+    void getBounds(vec3& minimum, vec3& maximum) const;
+
+    //LOD last drawn for every instance of a mesh, kept by the RenderQueue for hysteresis
+    uint8_t* getLodStates(size_t mesh);
 
 private:
+    vector<mat4> instances;
+    vector<uint8_t> lodStates;      // meshes x max(1, instances)
+    bool ready = false;
+
     
-    void loadModel(string path);
-    void processNode(aiNode* node, const aiScene* scene);
-    Mesh processMesh(aiMesh* mesh, const aiScene* scene);
-    vector<MeshTexture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName);
+    static void processNode(aiNode* node, const aiScene* scene, ModelData& data);
+    static MeshData processMesh(aiMesh* mesh, const aiScene* scene, ModelData& data);
+    static vector<MeshTexture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName, ModelData& data);
 };
\ No newline at end of file
@@ -0,0 +1,171 @@
+#include "OcclusionCuller.h"
+
+OcclusionCuller::OcclusionCuller(const OcclusionSettings& settings)
+	: width((std::max(settings.width, 4) + 3) & ~3), height(std::max(settings.height, 1)),
+	viewProjection(1.0f), occluderTriangles(0), tested(0), culled(0)
+{
+	depth.assign(size_t(width) * height, 1.0f);
+}
+
+void OcclusionCuller::begin(const mat4& viewProjection)
+{
+	this->viewProjection = viewProjection;
+	std::fill(depth.begin(), depth.end(), 1.0f);
+	occluderTriangles = tested = culled = 0;
+}
+
+void OcclusionCuller::addTriangles(const vector<vec3>& vertices)
+{
+	for (size_t i = 0; i + 2 < vertices.size(); i += 3) {
+		vec4 clip[3];
+		for (int k = 0; k < 3; k++) clip[k] = viewProjection * vec4(vertices[i + k], 1.0f);
+		drawTriangle(clip);
+	}
+}
+
+void OcclusionCuller::addBox(const mat4& transform, vec3 minimum, vec3 maximum)
+{
+	//corner i has bit 0 set for maximum x, bit 1 for y, bit 2 for z
+	static const int faces[6][4] = { { 0, 2, 6, 4 }, { 1, 5, 7, 3 }, { 0, 4, 5, 1 }, { 2, 3, 7, 6 }, { 0, 1, 3, 2 }, { 4, 6, 7, 5 } };
+
+	mat4 m = viewProjection * transform;
+	vec4 corners[8];
+	for (int i = 0; i < 8; i++)
+		corners[i] = m * vec4(i & 1 ? maximum.x : minimum.x, i & 2 ? maximum.y : minimum.y, i & 4 ? maximum.z : minimum.z, 1.0f);
+
+	for (const int* face : faces) {
+		vec4 first[3] = { corners[face[0]], corners[face[1]], corners[face[2]] };
+		vec4 second[3] = { corners[face[0]], corners[face[2]], corners[face[3]] };
+		drawTriangle(first);
+		drawTriangle(second);
+	}
+}
+
+bool OcclusionCuller::isVisible(const mat4& transform, vec3 minimum, vec3 maximum)
+{
+	tested++;
+	mat4 m = viewProjection * transform;
+	vec3 low(INFINITY), high(-INFINITY);
+	int nearCorners = 0;
+	for (int i = 0; i < 8; i++) {
+		vec4 clip = m * vec4(i & 1 ? maximum.x : minimum.x, i & 2 ? maximum.y : minimum.y, i & 4 ? maximum.z : minimum.z, 1.0f);
+		if (clip.z < -clip.w) {
+			nearCorners++;
+			continue;
+		}
+		vec3 p = toScreen(clip);
+		low = glm::min(low, p);
+		high = glm::max(high, p);
+	}
+
+	//a box crossing the near plane has no usable screen rectangle, one completely before it can't be seen
+	if (nearCorners > 0 && nearCorners < 8) return true;
+	if (nearCorners == 0 && testRect(low, high)) return true;
+	culled++;
+	return false;
+}
+
+vec3 OcclusionCuller::toScreen(vec4 clip) const
+{
+	vec3 ndc = vec3(clip) / clip.w;
+	return vec3((ndc.x * 0.5f + 0.5f) * width, (ndc.y * 0.5f + 0.5f) * height, ndc.z);
+}
+
+void OcclusionCuller::drawTriangle(const vec4 clip[3])
+{
+	occluderTriangles++;
+
+	//clip against the near plane (z >= -w), that leaves a triangle or a quad
+	vec4 polygon[4];
+	int count = 0;
+	for (int i = 0; i < 3; i++) {
+		const vec4& p = clip[i];
+		const vec4& q = clip[(i + 1) % 3];
+		float dp = p.z + p.w, dq = q.z + q.w;
+		if (dp >= 0.0f) polygon[count++] = p;
+		if ((dp >= 0.0f) != (dq >= 0.0f)) polygon[count++] = mix(p, q, dp / (dp - dq));
+	}
+
+	for (int i = 1; i + 1 < count; i++)
+		rasterize(toScreen(polygon[0]), toScreen(polygon[i]), toScreen(polygon[i + 1]));
+}
+
+void OcclusionCuller::rasterize(vec3 a, vec3 b, vec3 c)
+{
+	float area = (b.x - a.x) * (c.y - a.y) - (c.x - a.x) * (b.y - a.y);
+	if (std::abs(area) < 1e-6f) return;
+	if (area < 0.0f) {
+		std::swap(b, c);
+		area = -area;
+	}
+
+	//pixels whose centers are inside the bounding rectangle, columns in groups of four
+	vec3 low = glm::min(glm::min(a, b), c), high = glm::max(glm::max(a, b), c);
+	int x0 = int(glm::clamp(floor(low.x), 0.0f, float(width))) & ~3;
+	int x1 = int(glm::clamp(ceil(high.x), 0.0f, float(width)));
+	int y0 = int(glm::clamp(floor(low.y), 0.0f, float(height)));
+	int y1 = int(glm::clamp(ceil(high.y), 0.0f, float(height)));
+	if (x0 >= x1 || y0 >= y1) return;
+
+	//edge functions A * x + B * y + C, positive inside for counter clockwise triangles
+	const vec3 edges[3][2] = { { a, b }, { b, c }, { c, a } };
+	float edgeA[3], edgeB[3], edgeC[3];
+	for (int i = 0; i < 3; i++) {
+		vec3 p = edges[i][0], q = edges[i][1];
+		edgeA[i] = p.y - q.y;
+		edgeB[i] = q.x - p.x;
+		edgeC[i] = p.x * q.y - p.y * q.x;
+	}
+
+	//depth is linear in screen space after the perspective divide
+	vec3 e1 = b - a, e2 = c - a;
+	float dzdx = (e1.z * e2.y - e2.z * e1.y) / area;
+	float dzdy = (e2.z * e1.x - e1.z * e2.x) / area;
+
+	const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 stepZ = _mm_set1_ps(dzdx);
+	__m128 stepEdge[3];
+	for (int i = 0; i < 3; i++) stepEdge[i] = _mm_set1_ps(edgeA[i]);
+
+	for (int y = y0; y < y1; y++) {
+		float py = y + 0.5f;
+		__m128 rowEdge[3];
+		for (int i = 0; i < 3; i++) rowEdge[i] = _mm_set1_ps(edgeB[i] * py + edgeC[i]);
+		__m128 rowZ = _mm_set1_ps(a.z + dzdy * (py - a.y) - dzdx * a.x);
+		float* row = &depth[size_t(y) * width];
+
+		for (int x = x0; x < x1; x += 4) {
+			__m128 px = _mm_add_ps(_mm_set1_ps(float(x)), offsets);
+			__m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(stepEdge[0], px), rowEdge[0]), zero);
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(stepEdge[1], px), rowEdge[1]), zero));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(stepEdge[2], px), rowEdge[2]), zero));
+			if (_mm_movemask_ps(inside) == 0) continue;
+
+			//the nearer of both depths where covered, the old depth elsewhere
+			__m128 z = _mm_add_ps(_mm_mul_ps(stepZ, px), rowZ);
+			__m128 old = _mm_loadu_ps(row + x);
+			__m128 nearer = _mm_min_ps(old, z);
+			_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+		}
+	}
+}
+
+bool OcclusionCuller::testRect(vec3 minimum, vec3 maximum) const
+{
+	int x0 = int(glm::clamp(floor(minimum.x), 0.0f, float(width))) & ~3;
+	int x1 = int(glm::clamp(ceil(maximum.x), 0.0f, float(width)));
+	int y0 = int(glm::clamp(floor(minimum.y), 0.0f, float(height)));
+	int y1 = int(glm::clamp(ceil(maximum.y), 0.0f, float(height)));
+	if (x0 >= x1 || y0 >= y1) return false;		//outside of the view
+
+	//visible as soon as one pixel of the rectangle is farther than the nearest point of the box,
+	//the columns rounded out to groups of four only make the test more conservative
+	const __m128 nearest = _mm_set1_ps(minimum.z);
+	for (int y = y0; y < y1; y++) {
+		const float* row = &depth[size_t(y) * width];
+		for (int x = x0; x < x1; x += 4)
+			if (_mm_movemask_ps(_mm_cmpgt_ps(_mm_loadu_ps(row + x), nearest))) return true;
+	}
+	return false;
+}
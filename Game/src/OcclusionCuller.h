@@ -0,0 +1,61 @@
+#pragma once
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <emmintrin.h>
+#include <glm/glm.hpp>
+
+using namespace glm;
+using namespace std;
+
+struct OcclusionSettings {
+	bool enabled = true;
+	int width = 256;				//depth buffer resolution, the width is rounded up to a multiple of 4
+	int height = 128;
+	float terrainDistance = 500.0f;	//terrain cells closer than this to the camera are occluders
+	int terrainLevel = 1;			//quadtree level of those cells, see TerrainSettings::lodLevels
+};
+
+
+//Software occlusion culling on the CPU. A few simplified occluders (terrain cells, building
+//hulls) are rasterized into a small depth buffer with SSE, four pixels at a time, then the
+//screen rectangle of each object's bounding box is compared against it with its nearest depth.
+//Occluders must lie inside what they stand for, so an object is only culled if it is really
+//hidden; objects crossing the near plane are always visible. Needs no GL context.
+class OcclusionCuller
+{
+public:
+	OcclusionCuller(const OcclusionSettings& settings);
+
+	//clears the depth buffer and the counters for a new view
+	void begin(const mat4& viewProjection);
+
+	//world space triangles, three vertices each, both sides occlude
+	void addTriangles(const vector<vec3>& vertices);
+	//box in object space, e.g. a hull fitted inside a building
+	void addBox(const mat4& transform, vec3 minimum, vec3 maximum);
+
+	//false if the object space box is hidden behind the occluders or outside of the view
+	bool isVisible(const mat4& transform, vec3 minimum, vec3 maximum);
+
+	int getWidth() const { return width; }
+	int getHeight() const { return height; }
+	//normalized device depth per pixel, rows bottom to top, 1 where no occluder was drawn
+	const float* getDepth() const { return depth.data(); }
+
+	size_t getOccluderTriangleCount() const { return occluderTriangles; }
+	size_t getTestedCount() const { return tested; }
+	size_t getCulledCount() const { return culled; }
+
+private:
+	int width, height;
+	vector<float> depth;
+	mat4 viewProjection;
+	size_t occluderTriangles, tested, culled;
+
+	void drawTriangle(const vec4 clip[3]);
+	void rasterize(vec3 a, vec3 b, vec3 c);
+	vec3 toScreen(vec4 clip) const;
+	bool testRect(vec3 minimum, vec3 maximum) const;
+};
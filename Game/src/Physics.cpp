@@ -0,0 +1,161 @@
+#include "Physics.h"
+
+Physics::Physics(float fixedTimeStep, int maxStepsPerUpdate)
+	: fixedTimeStep(fixedTimeStep), maxStepsPerUpdate(maxStepsPerUpdate), accumulator(0.0f), simulationTime(0.0), running(false)
+{
+	collisionConfig = new btDefaultCollisionConfiguration();
+	dispatcher = new btCollisionDispatcher(collisionConfig);
+	broadphase = new btDbvtBroadphase();
+	solver = new btSequentialImpulseConstraintSolver();
+	world = new btDiscreteDynamicsWorld(dispatcher, broadphase, solver, collisionConfig);
+	world->setGravity(btVector3(0, -9.8, 0));
+
+	startTime = chrono::steady_clock::now();
+	previous.time = current.time = 0.0;
+}
+
+Physics::~Physics()
+{
+	stop();
+
+	for (btRigidBody* body : bodies) {
+		world->removeRigidBody(body);
+		delete body->getMotionState();
+		delete body->getCollisionShape();
+		delete body;
+	}
+
+	delete world;
+	delete solver;
+	delete broadphase;
+	delete dispatcher;
+	delete collisionConfig;
+}
+
+size_t Physics::addRigidBody(btRigidBody* body)
+{
+	size_t index;
+	{
+		lock_guard<mutex> lock(worldMutex);
+		world->addRigidBody(body);
+		bodies.push_back(body);
+		index = bodies.size() - 1;
+	}
+
+	//make the new body visible to the renderer right away
+	btTransform t;
+	body->getMotionState()->getWorldTransform(t);
+	btQuaternion r = t.getRotation();
+	BodyState state = { vec3(t.getOrigin().x(), t.getOrigin().y(), t.getOrigin().z()), quat(r.w(), r.x(), r.y(), r.z()) };
+
+	lock_guard<mutex> lock(snapshotMutex);
+	previous.bodies.resize(index + 1, state);
+	current.bodies.resize(index + 1, state);
+	return index;
+}
+
+void Physics::addStaticBody(btRigidBody* body)
+{
+	lock_guard<mutex> lock(worldMutex);
+	world->addRigidBody(body);
+}
+
+void Physics::removeStaticBody(btRigidBody* body)
+{
+	lock_guard<mutex> lock(worldMutex);
+	world->removeRigidBody(body);
+}
+
+void Physics::start()
+{
+	if (running) return;
+	running = true;
+	physicsThread = thread(&Physics::run, this);
+}
+
+void Physics::stop()
+{
+	if (!running) return;
+	running = false;
+	if (physicsThread.joinable()) physicsThread.join();
+}
+
+void Physics::update(float deltaTime)
+{
+	accumulator += deltaTime;
+
+	//drop time we can't catch up on instead of spiraling into ever longer steps
+	if (accumulator > fixedTimeStep * maxStepsPerUpdate) accumulator = fixedTimeStep * maxStepsPerUpdate;
+
+	while (accumulator >= fixedTimeStep) {
+		stepFixed();
+		accumulator -= fixedTimeStep;
+	}
+}
+
+mat4 Physics::getBodyMatrix(size_t index)
+{
+	BodyState a, b;
+	double alpha;
+	{
+		lock_guard<mutex> lock(snapshotMutex);
+		if (index >= current.bodies.size()) return mat4(1.0f);
+		a = previous.bodies.size() > index ? previous.bodies[index] : current.bodies[index];
+		b = current.bodies[index];
+
+		//render one step behind the simulation so there is always a state to blend towards
+		if (running) alpha = (now() - current.time) / fixedTimeStep;
+		else alpha = accumulator / fixedTimeStep;
+	}
+	alpha = clamp(alpha, 0.0, 1.0);
+
+	mat4 m = mat4_cast(slerp(a.rotation, b.rotation, float(alpha)));
+	m[3] = vec4(mix(a.position, b.position, float(alpha)), 1.0f);
+	return m;
+}
+
+void Physics::run()
+{
+	double last = now();
+	while (running) {
+		double t = now();
+		update(float(t - last));
+		last = t;
+
+		//sleep until the next step is due
+		double wait = fixedTimeStep - accumulator;
+		if (wait > 0.0) this_thread::sleep_for(chrono::duration<double>(wait));
+	}
+}
+
+void Physics::stepFixed()
+{
+	{
+		lock_guard<mutex> lock(worldMutex);
+		world->stepSimulation(fixedTimeStep, 0);
+		simulationTime += fixedTimeStep;
+
+		back.bodies.resize(bodies.size());
+		for (size_t i = 0; i < bodies.size(); i++) {
+			btTransform t;
+			bodies[i]->getMotionState()->getWorldTransform(t);
+			btQuaternion r = t.getRotation();
+			back.bodies[i].position = vec3(t.getOrigin().x(), t.getOrigin().y(), t.getOrigin().z());
+			back.bodies[i].rotation = quat(r.w(), r.x(), r.y(), r.z());
+		}
+	}
+	publish();
+}
+
+void Physics::publish()
+{
+	lock_guard<mutex> lock(snapshotMutex);
+	back.time = now();
+	swap(previous, current);
+	swap(current, back);
+}
+
+double Physics::now() const
+{
+	return chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+}
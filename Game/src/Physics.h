@@ -0,0 +1,85 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "btBulletCollisionCommon.h"
+#include "btBulletDynamicsCommon.h"
+
+using namespace glm;
+using namespace std;
+
+//Transform of a single body as published by the physics thread
+struct BodyState {
+	vec3 position;
+	quat rotation;
+};
+
+//Snapshot of all body transforms after one fixed physics step
+struct PhysicsSnapshot {
+	vector<BodyState> bodies;
+	double time;		//time (seconds since start) at which this step was completed
+};
+
+
+class Physics
+{
+public:
+	//Creates the dynamics world, simulation runs in steps of fixedTimeStep seconds
+	Physics(float fixedTimeStep = 1.0f / 60.0f, int maxStepsPerUpdate = 5);
+	~Physics();
+
+	//Adds a body to the world and returns its index for getBodyMatrix()
+	//Safe to call while the physics thread is running
+	size_t addRigidBody(btRigidBody* body);
+
+	//Static bodies that come and go (terrain tiles), they stay owned by the caller and get no render transform
+	//Safe to call while the physics thread is running
+	void addStaticBody(btRigidBody* body);
+	void removeStaticBody(btRigidBody* body);
+
+	//Starts/stops the physics thread
+	void start();
+	void stop();
+
+	//Advances the simulation on the calling thread (used when the physics thread is not running)
+	void update(float deltaTime);
+
+	//Returns the world transform of a body, interpolated between the last two physics steps
+	mat4 getBodyMatrix(size_t index);
+
+	btDynamicsWorld* getWorld() { return world; }
+
+private:
+	btDynamicsWorld* world;
+	btDispatcher* dispatcher;
+	btDefaultCollisionConfiguration* collisionConfig;
+	btBroadphaseInterface* broadphase;
+	btConstraintSolver* solver;
+	vector<btRigidBody*> bodies;
+
+	float fixedTimeStep;
+	int maxStepsPerUpdate;
+	float accumulator;
+	double simulationTime;
+
+	thread physicsThread;
+	atomic<bool> running;
+	mutex worldMutex;		//guards world and bodies
+	mutex snapshotMutex;	//guards previous/current snapshots
+
+	//double buffered body transforms, render interpolates from previous to current
+	PhysicsSnapshot previous, current;
+	PhysicsSnapshot back;	//written by the physics thread, swapped into current
+	chrono::steady_clock::time_point startTime;
+
+	void run();
+	void stepFixed();
+	void publish();
+	double now() const;
+};
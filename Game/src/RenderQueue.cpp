@@ -0,0 +1,215 @@
+#include "RenderQueue.h"
+
+//a coarser level has to get this much better than the threshold before the finer one comes back,
+//keeps objects near the switching distance from flickering between levels
+const float LOD_HYSTERESIS = 0.25f;
+
+RenderQueue::RenderQueue()
+	: lodPixelScale(0.0f), lodPixelError(1.0f)
+{
+	glCreateBuffers(1, &transformBuffer);
+	glCreateBuffers(1, &commandBuffer);
+}
+
+RenderQueue::~RenderQueue()
+{
+	glDeleteBuffers(1, &transformBuffer);
+	glDeleteBuffers(1, &commandBuffer);
+}
+
+//key layout (most significant first):	program 12 bits | texture 16 bits | index type 1 bit | depth 20 bits
+//ids wider than their field only cost sorting quality, execute() compares the real state
+uint64_t RenderQueue::makeKey(GLuint program, GLuint texture, GLenum indexType, float depth)
+{
+	const float maxDepth = 4096.0f;		//depth is quantized over [0, maxDepth)
+	uint64_t d = uint64_t(glm::clamp(depth / maxDepth, 0.0f, 1.0f) * 0xFFFFF);
+
+	return (uint64_t(program & 0xFFF) << 37)
+		| (uint64_t(texture & 0xFFFF) << 21)
+		| (uint64_t(indexType == GL_UNSIGNED_INT) << 20)
+		| (d & 0xFFFFF);
+}
+
+static bool sameTextures(const Mesh& a, const Mesh& b)
+{
+	if (a.textures.size() != b.textures.size()) return false;
+	for (size_t i = 0; i < a.textures.size(); i++)
+		if (a.textures[i].id != b.textures[i].id) return false;
+	return true;
+}
+
+//items can share one multi draw if nothing has to be rebound between them
+static bool sameState(const DrawItem& a, const DrawItem& b)
+{
+	if (a.shader != b.shader || a.mesh->getIndexType() != b.mesh->getIndexType()) return false;
+	if (a.mesh->getTextureKey() || b.mesh->getTextureKey()) return sameTextures(*a.mesh, *b.mesh);
+	return a.texture == b.texture;
+}
+
+//the mesh's own maps pick the variant, the submitted texture stands in as diffuse map for meshes without textures
+Shader& RenderQueue::variantFor(ShaderVariants& shaders, const Mesh& mesh, GLuint texture)
+{
+	unsigned int features = mesh.getShaderFeatures();
+	if (!mesh.getTextureKey() && texture) features |= SHADER_DIFFUSE_MAP;
+	return shaders.get(features);
+}
+
+void RenderQueue::submit(ShaderVariants& shaders, Model& model, const mat4& transform, GLuint texture)
+{
+	if (!model.isReady()) return;
+	GLuint first = GLuint(transforms.size());
+	transforms.push_back(transform);
+	for (Mesh& mesh : model.meshes) {
+		DrawItem item = { 0, &variantFor(shaders, mesh, texture), &mesh, texture, first, 1, 0.0f, 0, model.getLodStates(&mesh - &model.meshes[0]), nullptr };
+		items.push_back(item);
+	}
+}
+
+void RenderQueue::submitInstanced(ShaderVariants& shaders, Model& model, GLuint texture, const uint8_t* visibility)
+{
+	if (!model.isReady() || model.getInstanceCount() == 0) return;
+	GLuint first = GLuint(transforms.size());
+	transforms.insert(transforms.end(), model.getInstances().begin(), model.getInstances().end());
+	for (Mesh& mesh : model.meshes) {
+		DrawItem item = { 0, &variantFor(shaders, mesh, texture), &mesh, texture, first, model.getInstanceCount(), 0.0f, 0, model.getLodStates(&mesh - &model.meshes[0]), visibility };
+		items.push_back(item);
+	}
+}
+
+void RenderQueue::setLodProjection(float viewportHeight, float fovy, float pixelError)
+{
+	lodPixelScale = viewportHeight / (2.0f * tan(fovy * 0.5f));
+	lodPixelError = pixelError;
+}
+
+GLuint RenderQueue::chooseLod(const Mesh& mesh, const mat4& transform, vec3 viewPosition, uint8_t& state) const
+{
+	//errors are in object space, the largest axis scale bounds how much the transform grows them
+	float scale = sqrt(std::max(std::max(dot(transform[0], transform[0]), dot(transform[1], transform[1])), dot(transform[2], transform[2])));
+	vec3 center = vec3(transform * vec4(mesh.getBoundsCenter(), 1.0f));
+	float distance = std::max(length(center - viewPosition) - mesh.getBoundsRadius() * scale, 0.1f);
+	float pixels = lodPixelScale * scale / distance;	//on screen size of one object space unit
+
+	GLuint lod = glm::min(GLuint(state), GLuint(mesh.getLodCount() - 1));
+	while (lod + 1 < mesh.getLodCount() && mesh.getLod(lod + 1).error * pixels <= lodPixelError) lod++;
+	while (lod > 0 && mesh.getLod(lod).error * pixels > lodPixelError * (1.0f + LOD_HYSTERESIS)) lod--;
+	state = uint8_t(lod);
+	return lod;
+}
+
+void RenderQueue::selectLods(vec3 viewPosition)
+{
+	lodItems.clear();
+	for (const DrawItem& item : items) {
+		bool selectLod = item.mesh->getLodCount() > 1 && lodPixelScale > 0.0f;
+		if (!selectLod && !item.visibility) {
+			lodItems.push_back(item);
+			continue;
+		}
+
+		if (item.instanceCount == 1 && !item.visibility) {
+			DrawItem single = item;
+			single.lod = chooseLod(*item.mesh, transforms[item.firstTransform], viewPosition, item.lodStates[0]);
+			lodItems.push_back(single);
+			continue;
+		}
+
+		//instances are regrouped so every LOD is drawn once with consecutive transforms, hidden ones are left out
+		lodInstances.resize(item.mesh->getLodCount());
+		for (vector<GLuint>& list : lodInstances) list.clear();
+		for (GLsizei i = 0; i < item.instanceCount; i++) {
+			if (item.visibility && !item.visibility[i]) continue;
+			GLuint lod = selectLod ? chooseLod(*item.mesh, transforms[item.firstTransform + i], viewPosition, item.lodStates[i]) : 0;
+			lodInstances[lod].push_back(item.firstTransform + i);
+		}
+
+		for (size_t lod = 0; lod < lodInstances.size(); lod++) {
+			if (lodInstances[lod].empty()) continue;
+			DrawItem group = item;
+			group.lod = GLuint(lod);
+			group.firstTransform = GLuint(transforms.size());
+			group.instanceCount = GLsizei(lodInstances[lod].size());
+			for (GLuint t : lodInstances[lod]) transforms.push_back(transforms[t]);
+			lodItems.push_back(group);
+		}
+	}
+	items.swap(lodItems);
+}
+
+void RenderQueue::execute(vec3 viewPosition)
+{
+	if (items.empty()) {
+		transforms.clear();		//a model without meshes adds its transforms but no item
+		return;
+	}
+
+	selectLods(viewPosition);
+
+	for (DrawItem& item : items) {
+		GLuint texture = item.mesh->getTextureKey() ? item.mesh->getTextureKey() : item.texture;
+		if (item.instanceCount == 1) item.depth = length(vec3(transforms[item.firstTransform][3]) - viewPosition);
+		item.key = makeKey(item.shader->ID, texture, item.mesh->getIndexType(), item.depth);
+	}
+	sort(items.begin(), items.end(), [](const DrawItem& a, const DrawItem& b) { return a.key < b.key; });
+
+	//one indirect command per item, baseInstance points the draw index at the item's transforms
+	commands.clear();
+	for (const DrawItem& item : items) {
+		const MeshLod& lod = item.mesh->getLod(item.lod);
+		DrawElementsIndirectCommand cmd = { lod.indexCount, GLuint(item.instanceCount),
+			item.mesh->getFirstIndex() + lod.firstIndex, item.mesh->getBaseVertex(), item.firstTransform };
+		commands.push_back(cmd);
+	}
+
+	//normals are transformed by the inverse transpose, once per transform here instead of per vertex
+	drawTransforms.resize(transforms.size());
+	for (size_t i = 0; i < transforms.size(); i++) {
+		mat3 normalMatrix = transpose(inverse(mat3(transforms[i])));
+		drawTransforms[i].modelMatrix = transforms[i];
+		for (int c = 0; c < 3; c++) drawTransforms[i].normalMatrix[c] = vec4(normalMatrix[c], 0.0f);
+	}
+
+	//buffers are respecified every frame so the driver doesn't have to wait on last frame's draws
+	glNamedBufferData(transformBuffer, drawTransforms.size() * sizeof(DrawTransform), drawTransforms.data(), GL_STREAM_DRAW);
+	glNamedBufferData(commandBuffer, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_STREAM_DRAW);
+
+	GeometryArena& arena = GeometryArena::get();
+	arena.reserveDrawIndices(transforms.size());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_DATA_BINDING, transformBuffer);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+
+	Shader* currentShader = nullptr;
+	GLenum currentIndexType = 0;
+	size_t first = 0;
+	while (first < items.size()) {
+		size_t last = first + 1;
+		while (last < items.size() && sameState(items[first], items[last])) last++;
+
+		DrawItem& item = items[first];
+		if (item.shader != currentShader) {
+			item.shader->use();
+			currentShader = item.shader;
+		}
+
+		if (item.mesh->getIndexType() != currentIndexType) {
+			arena.bind(item.mesh->getIndexType());
+			currentIndexType = item.mesh->getIndexType();
+		}
+
+		//material: the mesh's own textures, or the texture the item was submitted with
+		if (item.mesh->getTextureKey()) {
+			item.mesh->bindTextures();
+		} else if (item.texture) {
+			glBindTextureUnit(0, item.texture);
+		}
+
+		glMultiDrawElementsIndirect(GL_TRIANGLES, currentIndexType,
+			(void*)(first * sizeof(DrawElementsIndirectCommand)), GLsizei(last - first), 0);
+		first = last;
+	}
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	glBindVertexArray(0);
+	items.clear();
+	transforms.clear();
+}
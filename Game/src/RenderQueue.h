@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "Shader.h"
+#include "ShaderVariants.h"
+#include "Mesh.h"
+#include "Model.h"
+#include "GeometryArena.h"
+
+using namespace glm;
+using namespace std;
+
+//Binding point of the per-draw data storage buffer (DrawData block in the vertex shader)
+const GLuint DRAW_DATA_BINDING = 0;
+
+//One entry of the DrawData block, std430: the mat3 columns are padded to vec4
+struct DrawTransform {
+	mat4 modelMatrix;
+	vec4 normalMatrix[3];	//transpose(inverse(mat3(modelMatrix))), computed once per object instead of per vertex
+};
+
+static_assert(sizeof(DrawTransform) == 112, "draw transforms must match the std430 layout");
+
+//One mesh to be drawn with a given program, material and one or more transforms
+struct DrawItem {
+	uint64_t key;			//sort key, see RenderQueue::makeKey
+	Shader* shader;
+	Mesh* mesh;
+	GLuint texture;			//texture bound to unit 0 for meshes without textures of their own (0 = none)
+	GLuint firstTransform;	//index of the first model matrix in the per-draw buffer
+	GLsizei instanceCount;	//number of consecutive model matrices drawn
+	float depth;			//distance to the camera, 0 for instanced items
+	GLuint lod;				//level of detail of the mesh that is drawn
+	uint8_t* lodStates;		//LOD chosen last frame per instance, owned by the model
+	const uint8_t* visibility;	//per instance, 0 skips it (nullptr = all drawn), owned by the caller until execute()
+};
+
+
+//Collects draw items for a frame, sorts them by state and draws every run of items
+//sharing program and textures with a single glMultiDrawElementsIndirect call
+class RenderQueue
+{
+public:
+	RenderQueue();
+	~RenderQueue();
+
+	//each mesh is drawn with the variant of shaders that matches its material
+	void submit(ShaderVariants& shaders, Model& model, const mat4& transform, GLuint texture = 0);
+	//visibility has a byte per instance, 0 for instances culled by the caller
+	void submitInstanced(ShaderVariants& shaders, Model& model, GLuint texture = 0, const uint8_t* visibility = nullptr);
+
+	//LODs are picked so their error stays under pixelError pixels on a viewport of the given height
+	void setLodProjection(float viewportHeight, float fovy, float pixelError = 1.0f);
+
+	//sorts by program -> texture set -> index type -> depth (front to back), draws and clears the queue
+	void execute(vec3 viewPosition);
+
+	size_t size() const { return items.size(); }
+
+private:
+	vector<DrawItem> items;
+	vector<mat4> transforms;						//model matrices of this frame, indexed by the draw index
+	vector<DrawTransform> drawTransforms;			//transforms with their normal matrices, uploaded to DrawData
+	vector<DrawElementsIndirectCommand> commands;
+	GLuint transformBuffer, commandBuffer;
+	float lodPixelScale, lodPixelError;				//pixels per world unit at distance 1, error threshold in pixels
+	vector<DrawItem> lodItems;
+	vector<vector<GLuint>> lodInstances;
+
+	void selectLods(vec3 viewPosition);
+	GLuint chooseLod(const Mesh& mesh, const mat4& transform, vec3 viewPosition, uint8_t& state) const;
+	static Shader& variantFor(ShaderVariants& shaders, const Mesh& mesh, GLuint texture);
+	static uint64_t makeKey(GLuint program, GLuint texture, GLenum indexType, float depth);
+};
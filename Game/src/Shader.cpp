@@ -1,7 +1,7 @@
 #include "Shader.h"
 
 
-Shader::Shader(const char* vertexPath, const char* fragmentPath)
+Shader::Shader(const char* vertexPath, const char* fragmentPath, const std::string& defines)
 {
 
     // 1. retrieve the vertex/fragment source code from filePath
@@ -31,11 +31,27 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath)
     } catch (std::ifstream::failure e) {
         std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
     }
+    insertDefines(vertexCode, defines);
+    insertDefines(fragmentCode, defines);
 
+    // 2. reuse the program binary from the last run if sources and driver are unchanged
+    ID = glCreateProgram();
+    std::string cachePath = programCachePath(vertexPath, fragmentPath, defines);
+    uint64_t key = programCacheKey(vertexCode, fragmentCode);
+    if (!loadBinary(cachePath, key)) {
+        compile(vertexCode, fragmentCode);
+        saveBinary(cachePath, key);
+    }
+
+    reflectUniforms();
+}
+
+void Shader::compile(const std::string& vertexCode, const std::string& fragmentCode)
+{
     const char* vShaderCode = vertexCode.c_str();
     const char* fShaderCode = fragmentCode.c_str();
 
-    // 2. compile shaders
+    // compile shaders
     GLuint vertex, fragment;
     int success;
     char infoLog[512];
@@ -63,7 +79,7 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath)
     };
 
     // shader Program
-    ID = glCreateProgram();
+    glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glAttachShader(ID, vertex);
     glAttachShader(ID, fragment);
     glLinkProgram(ID);
@@ -75,10 +91,132 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath)
     }
 
     // delete the shaders as they're linked into our program now and no longer necessery
+    glDetachShader(ID, vertex);
+    glDetachShader(ID, fragment);
     glDeleteShader(vertex);
     glDeleteShader(fragment);
 }
 
+void Shader::insertDefines(std::string& code, const std::string& defines)
+{
+    // #version has to stay the first statement
+    if (defines.empty()) return;
+    size_t version = code.find("#version");
+    size_t lineEnd = version == std::string::npos ? std::string::npos : code.find('\n', version);
+    if (lineEnd == std::string::npos) code.insert(0, defines);
+    else code.insert(lineEnd + 1, defines);
+}
+
+std::string Shader::programCachePath(const char* vertexPath, const char* fragmentPath, const std::string& defines)
+{
+    // one file per vertex/fragment pair and variant, next to the vertex shader
+    std::string fragment = fragmentPath;
+    size_t slash = fragment.find_last_of("/\\");
+    if (slash != std::string::npos) fragment = fragment.substr(slash + 1);
+    std::string path = std::string(vertexPath) + "+" + fragment;
+    if (!defines.empty()) {
+        char hash[17];
+        snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)hashBytes(defines.data(), defines.size()));
+        path += std::string(".") + hash;
+    }
+    return path + ".program";
+}
+
+uint64_t Shader::programCacheKey(const std::string& vertexCode, const std::string& fragmentCode)
+{
+    // binaries are only valid for the driver that produced them
+    uint64_t key = hashBytes(vertexCode.data(), vertexCode.size());
+    key = hashBytes(fragmentCode.data(), fragmentCode.size(), key);
+    for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+        const char* value = reinterpret_cast<const char*>(glGetString(name));
+        if (value) key = hashBytes(value, strlen(value), key);
+    }
+    return key;
+}
+
+bool Shader::loadBinary(const std::string& path, uint64_t key)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) return false;
+    std::streamoff fileSize = file.tellg();
+    file.seekg(0);
+
+    ProgramBinaryHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+    if (memcmp(header.magic, "PRG0", 4) != 0 || header.version != PROGRAM_BINARY_VERSION || header.key != key) return false;
+
+    // a truncated or damaged file must not decide how much is allocated
+    if (header.size == 0 || std::streamoff(header.size) > fileSize - std::streamoff(sizeof(header))) return false;
+
+    std::vector<char> binary(header.size);
+    if (!file.read(binary.data(), binary.size())) return false;
+
+    // the driver may still reject the binary (e.g. after an update that kept the version string)
+    int success = 0;
+    glProgramBinary(ID, header.format, binary.data(), GLsizei(binary.size()));
+    glGetProgramiv(ID, GL_LINK_STATUS, &success);
+    if (!success) std::cout << "Shader: cached program " << path << " rejected by the driver, recompiling" << std::endl;
+    return success != 0;
+}
+
+void Shader::saveBinary(const std::string& path, uint64_t key)
+{
+    GLint formats = 0, success = 0, length = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    glGetProgramiv(ID, GL_LINK_STATUS, &success);
+    glGetProgramiv(ID, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (formats == 0 || !success || length <= 0) return;
+
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(ID, length, &length, &format, binary.data());
+
+    ProgramBinaryHeader header = { { 'P', 'R', 'G', '0' }, PROGRAM_BINARY_VERSION, key, format, uint32_t(length) };
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) return;
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(binary.data(), length);
+}
+
+void Shader::reflectUniforms()
+{
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+    std::string name(maxLength, '\0');
+    for (GLint i = 0; i < count; i++) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type;
+        glGetActiveUniform(ID, i, maxLength, &length, &size, &type, &name[0]);
+        std::string uniformName = name.substr(0, length);
+
+        GLint location = glGetUniformLocation(ID, uniformName.c_str());
+        if (location < 0) continue;     // member of a uniform block
+        uniformLocations[uniformName] = location;
+
+        // arrays are reported as "name[0]", also register "name" and every element
+        size_t bracket = uniformName.rfind("[0]");
+        if (bracket != std::string::npos && bracket + 3 == uniformName.size()) {
+            std::string base = uniformName.substr(0, bracket);
+            uniformLocations[base] = location;
+            for (GLint j = 1; j < size; j++) {
+                std::string element = base + "[" + std::to_string(j) + "]";
+                uniformLocations[element] = glGetUniformLocation(ID, element.c_str());
+            }
+        }
+    }
+}
+
+Uniform Shader::uniform(const std::string& name) const
+{
+    Uniform u;
+    auto it = uniformLocations.find(name);
+    if (it != uniformLocations.end()) u.location = it->second;
+    return u;
+}
+
 void Shader::use()
 {
     glUseProgram(ID);
@@ -86,35 +224,60 @@ void Shader::use()
 
 void Shader::setFloat(const std::string& name, float value) const
 {
-    glUniform1f( glGetUniformLocation(ID, name.c_str()), value);
+    setFloat(uniform(name), value);
 }
 
 void Shader::setInt(const std::string& name, int value) const
 {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+    setInt(uniform(name), value);
 }
 
 void Shader::setInt2(const std::string& name, int x, int y) const
 {
-    glUniform2i(glGetUniformLocation(ID, name.c_str()), x, y);
+    glUniform2i(uniform(name).location, x, y);
 }
 
 
-void Shader::setVec3(const std::string& name, GLsizei count, glm::vec3& value) const {
+void Shader::setVec3(const std::string& name, GLsizei count, const glm::vec3& value) const {
 
-    glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    setVec3(uniform(name), value);
 }
 
-void Shader::setVec2(const std::string& name, GLsizei count, glm::vec2& value) const {
+void Shader::setVec2(const std::string& name, GLsizei count, const glm::vec2& value) const {
 
-    glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    setVec2(uniform(name), value);
 }
 /*void Shader::setMat4(const std::string& name, GLsizei count, GLboolean transpose, glm::mat4& value) const
 {
     glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &value[0][0]);
 }*/
 
-void Shader::setMat4(const std::string& name, GLsizei count, GLboolean transpose, glm::mat4 value) const
+void Shader::setMat4(const std::string& name, GLsizei count, GLboolean transpose, const glm::mat4& value) const
 {
-    glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &value[0][0]);
+    setMat4(uniform(name), value);
+}
+
+void Shader::setFloat(Uniform u, float value) const
+{
+    glUniform1f(u.location, value);
+}
+
+void Shader::setInt(Uniform u, int value) const
+{
+    glUniform1i(u.location, value);
+}
+
+void Shader::setVec2(Uniform u, const glm::vec2& value) const
+{
+    glUniform2fv(u.location, 1, &value[0]);
+}
+
+void Shader::setVec3(Uniform u, const glm::vec3& value) const
+{
+    glUniform3fv(u.location, 1, &value[0]);
+}
+
+void Shader::setMat4(Uniform u, const glm::mat4& value) const
+{
+    glUniformMatrix4fv(u.location, 1, GL_FALSE, &value[0][0]);
 }
@@ -7,11 +7,33 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <cstdint>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
+#include "Hash.h"
 
 
+//Pre-resolved uniform location of one program, get it once with Shader::uniform()
+struct Uniform {
+	GLint location = -1;
+};
+
+
+//Header of a cached program binary (<vertex path>+<fragment file>[.<defines hash>].program)
+const uint32_t PROGRAM_BINARY_VERSION = 1;
+
+struct ProgramBinaryHeader {
+	char magic[4];			//"PRG0"
+	uint32_t version;
+	uint64_t key;			//hash of both sources and the driver's vendor/renderer/version strings
+	uint32_t format;		//driver specific format from glGetProgramBinary
+	uint32_t size;			//bytes of binary that follow the header
+};
 
 
 class Shader
@@ -19,26 +41,49 @@ class Shader
 public:
 	GLuint ID;
 
-	Shader(const char* vertexPath, const char* fragmentPath);
+	//loads the linked program from the binary cache, sources are only compiled if the cache is missing or stale
+	//defines ("#define NAME VALUE" lines) are inserted after the #version line of both sources
+	Shader(const char* vertexPath, const char* fragmentPath, const std::string& defines = "");
 
 	//activate the shader
 	void use();
 
-	//uniform functions
+	//returns the cached location of an active uniform (location -1 if the program doesn't use it)
+	Uniform uniform(const std::string& name) const;
+
+	//uniform functions, names are looked up in the reflected uniform table, never in the driver
 	void setFloat(const std::string& name, float value) const;
 
 	void setInt(const std::string& name, int value) const;
 
 	void setInt2(const std::string& name, int x, int y) const;
 
-	void setVec2(const std::string& name, GLsizei count, glm::vec2& value) const;
+	void setVec2(const std::string& name, GLsizei count, const glm::vec2& value) const;
 
-	void setVec3(const std::string& name, GLsizei count, glm::vec3& value) const;
+	void setVec3(const std::string& name, GLsizei count, const glm::vec3& value) const;
 
 	//void setMat4(const std::string& name, GLsizei count, GLboolean transpose, glm::mat4& value) const;
-	void setMat4(const std::string& name, GLsizei count, GLboolean transpose, glm::mat4 value) const;
-
-	
+	void setMat4(const std::string& name, GLsizei count, GLboolean transpose, const glm::mat4& value) const;
+
+	//uniform functions for pre-resolved handles
+	void setFloat(Uniform u, float value) const;
+	void setInt(Uniform u, int value) const;
+	void setVec2(Uniform u, const glm::vec2& value) const;
+	void setVec3(Uniform u, const glm::vec3& value) const;
+	void setMat4(Uniform u, const glm::mat4& value) const;
+
+private:
+	std::unordered_map<std::string, GLint> uniformLocations;
+
+	//queries all active uniforms once after linking
+	void reflectUniforms();
+
+	void compile(const std::string& vertexCode, const std::string& fragmentCode);
+	bool loadBinary(const std::string& path, uint64_t key);
+	void saveBinary(const std::string& path, uint64_t key);
+	static std::string programCachePath(const char* vertexPath, const char* fragmentPath, const std::string& defines);
+	static void insertDefines(std::string& code, const std::string& defines);
+	static uint64_t programCacheKey(const std::string& vertexCode, const std::string& fragmentCode);
 };
 
 
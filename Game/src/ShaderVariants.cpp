@@ -0,0 +1,27 @@
+#include "ShaderVariants.h"
+
+static const char* const FEATURE_DEFINES[SHADER_FEATURE_COUNT] = { "DIFFUSE_MAP", "SPECULAR_MAP" };
+
+ShaderVariants::ShaderVariants(const std::string& vertexPath, const std::string& fragmentPath, const std::string& defines,
+	std::function<void(Shader&)> setup, unsigned int supportedFeatures)
+	: vertexPath(vertexPath), fragmentPath(fragmentPath), defines(defines), setup(setup), supportedFeatures(supportedFeatures)
+{
+}
+
+Shader& ShaderVariants::get(unsigned int features)
+{
+	features &= supportedFeatures;
+	std::unique_ptr<Shader>& variant = variants[features];
+	if (variant) return *variant;
+
+	std::string variantDefines = defines;
+	for (int i = 0; i < SHADER_FEATURE_COUNT; i++)
+		if (features & (1 << i)) variantDefines += std::string("#define ") + FEATURE_DEFINES[i] + "\n";
+
+	variant.reset(new Shader(vertexPath.c_str(), fragmentPath.c_str(), variantDefines));
+	if (setup) {
+		variant->use();
+		setup(*variant);
+	}
+	return *variant;
+}
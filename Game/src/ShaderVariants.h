@@ -0,0 +1,36 @@
+#pragma once
+#include <string>
+#include <memory>
+#include <functional>
+#include "Shader.h"
+
+//Optional parts of a shader, each variant is compiled with a #define per feature it uses
+enum ShaderFeature : unsigned int {
+	SHADER_DIFFUSE_MAP = 1 << 0,		//DIFFUSE_MAP: diffuse color from the texture on unit 0, else material.color
+	SHADER_SPECULAR_MAP = 1 << 1,		//SPECULAR_MAP: specular color from the texture on unit 1, else material.specular
+};
+const int SHADER_FEATURE_COUNT = 2;
+const unsigned int SHADER_ALL_FEATURES = (1 << SHADER_FEATURE_COUNT) - 1;
+
+//All variants of one vertex/fragment pair. Variants are compiled the first time they are
+//requested, so only the feature combinations the scene actually draws are ever built.
+class ShaderVariants
+{
+public:
+	//defines are added to every variant (e.g. light counts), setup runs once on each new variant to set its constant uniforms,
+	//features the shader doesn't implement are ignored so requests that only differ in them share one variant
+	ShaderVariants(const std::string& vertexPath, const std::string& fragmentPath, const std::string& defines = "",
+		std::function<void(Shader&)> setup = nullptr, unsigned int supportedFeatures = SHADER_ALL_FEATURES);
+
+	ShaderVariants(const ShaderVariants&) = delete;
+	ShaderVariants& operator=(const ShaderVariants&) = delete;
+
+	//features is a combination of ShaderFeature bits
+	Shader& get(unsigned int features);
+
+private:
+	std::string vertexPath, fragmentPath, defines;
+	std::function<void(Shader&)> setup;
+	unsigned int supportedFeatures;
+	std::unique_ptr<Shader> variants[1 << SHADER_FEATURE_COUNT];
+};
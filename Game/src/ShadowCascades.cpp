@@ -0,0 +1,141 @@
+#include "ShadowCascades.h"
+
+ShadowCascades::ShadowCascades(const ShadowSettings& settings)
+	: settings(settings), lightDirection(0.0f), staticVersion(0), staticRefreshes(0), block(sizeof(ShadowBlock), SHADOW_BLOCK_BINDING)
+{
+	for (Cascade& cascade : cascades) cascade = { mat4(1.0f), vec3(0.0f), 0.0f, true };
+
+	staticMaps = createMaps(false);
+	shadowMaps = createMaps(true);
+
+	//depth only, no color attachment
+	glCreateFramebuffers(1, &fbo);
+	glNamedFramebufferDrawBuffer(fbo, GL_NONE);
+	glNamedFramebufferReadBuffer(fbo, GL_NONE);
+}
+
+ShadowCascades::~ShadowCascades()
+{
+	glDeleteFramebuffers(1, &fbo);
+	glDeleteTextures(1, &staticMaps);
+	glDeleteTextures(1, &shadowMaps);
+}
+
+GLuint ShadowCascades::createMaps(bool compare)
+{
+	GLuint texture;
+	glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &texture);
+	glTextureStorage3D(texture, 1, GL_DEPTH_COMPONENT32F, settings.resolution, settings.resolution, SHADOW_CASCADES);
+	glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, compare ? GL_LINEAR : GL_NEAREST);
+	glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, compare ? GL_LINEAR : GL_NEAREST);
+	glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+	glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+	float border[] = { 1.0f, 1.0f, 1.0f, 1.0f };		//outside a cascade is lit
+	glTextureParameterfv(texture, GL_TEXTURE_BORDER_COLOR, border);
+	if (compare) {
+		//hardware compares and filters 2x2 texels per lookup
+		glTextureParameteri(texture, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+		glTextureParameteri(texture, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	}
+	return texture;
+}
+
+void ShadowCascades::update(const mat4& view, float fovy, float aspect, float zNear, vec3 lightDirection, uint64_t staticVersion)
+{
+	lightDirection = normalize(lightDirection);
+	bool sceneChanged = lightDirection != this->lightDirection || staticVersion != this->staticVersion;
+	this->lightDirection = lightDirection;
+	this->staticVersion = staticVersion;
+
+	vec3 up = abs(lightDirection.y) > 0.99f ? vec3(0.0f, 0.0f, 1.0f) : vec3(0.0f, 1.0f, 0.0f);
+	mat4 lightView = lookAt(vec3(0.0f), lightDirection, up);
+	mat4 inverseView = inverse(view);
+	float tanY = tan(fovy * 0.5f), tanX = tanY * aspect;
+
+	ShadowBlock data;
+	float sliceNear = zNear;
+	for (int i = 0; i < SHADOW_CASCADES; i++) {
+		//practical split scheme, a blend of logarithmic and linear splits
+		float t = float(i + 1) / SHADOW_CASCADES;
+		float logSplit = zNear * pow(settings.distance / zNear, t);
+		float linearSplit = zNear + (settings.distance - zNear) * t;
+		float sliceFar = mix(linearSplit, logSplit, settings.splitLambda);
+		data.cascadeSplits[i] = sliceFar;
+
+		//bounding sphere of the slice, on the view axis so its size doesn't change when the camera turns
+		float diagonalNear = sliceNear * length(vec2(tanX, tanY)), diagonalFar = sliceFar * length(vec2(tanX, tanY));
+		float depth = glm::clamp((sliceFar * sliceFar + diagonalFar * diagonalFar - sliceNear * sliceNear - diagonalNear * diagonalNear)
+			/ (2.0f * (sliceFar - sliceNear)), sliceNear, sliceFar);
+		float radius = std::max(length(vec2(depth - sliceNear, diagonalNear)), length(vec2(sliceFar - depth, diagonalFar)));
+		vec3 center = vec3(lightView * inverseView * vec4(0.0f, 0.0f, -depth, 1.0f));
+
+		//the cascade moves in whole snap steps (a multiple of its texels) and is large enough to hold
+		//the sphere anywhere within a step, so the cache stays valid while the camera moves inside it
+		float halfSize = ceil(radius * 1.25f);
+		float texel = 2.0f * halfSize / settings.resolution;
+		float snap = std::max(1.0f, floor((halfSize - radius) / texel)) * texel;
+		center = floor(center / snap + 0.5f) * snap;
+
+		Cascade& cascade = cascades[i];
+		if (sceneChanged || center != cascade.center || halfSize != cascade.halfSize) cascade.stale = true;
+		cascade.center = center;
+		cascade.halfSize = halfSize;
+		//light space looks down -z, casters up to casterDistance in front of the cascade are included
+		mat4 projection = ortho(center.x - halfSize, center.x + halfSize, center.y - halfSize, center.y + halfSize,
+			-center.z - halfSize - settings.casterDistance, -center.z + halfSize);
+		cascade.lightMatrix = projection * lightView;
+		data.lightMatrices[i] = cascade.lightMatrix;
+
+		sliceNear = sliceFar;
+	}
+	block.update(&data, sizeof(data));
+}
+
+void ShadowCascades::attachLayer(GLuint texture, int layer)
+{
+	glNamedFramebufferTextureLayer(fbo, GL_DEPTH_ATTACHMENT, texture, 0, layer);
+}
+
+void ShadowCascades::render(const DrawCasters& drawStatic, const DrawCasters& drawDynamic)
+{
+	//the benchmark may render into its own framebuffer, put it back afterwards
+	GLint previousFbo, viewport[4];
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFbo);
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glViewport(0, 0, settings.resolution, settings.resolution);
+	glEnable(GL_DEPTH_TEST);
+	glDepthMask(GL_TRUE);
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(2.0f, 4.0f);		//slope scaled bias against shadow acne
+
+	staticRefreshes = 0;
+	for (int i = 0; i < SHADOW_CASCADES; i++) {
+		Cascade& cascade = cascades[i];
+		Frustum frustum(cascade.lightMatrix);
+
+		if (cascade.stale) {
+			attachLayer(staticMaps, i);
+			glClear(GL_DEPTH_BUFFER_BIT);
+			drawStatic(cascade.lightMatrix, frustum);
+			cascade.stale = false;
+			staticRefreshes++;
+		}
+
+		//start from the cached static depth, dynamic casters are drawn on top
+		glCopyImageSubData(staticMaps, GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, shadowMaps, GL_TEXTURE_2D_ARRAY, 0, 0, 0, i,
+			settings.resolution, settings.resolution, 1);
+		attachLayer(shadowMaps, i);
+		drawDynamic(cascade.lightMatrix, frustum);
+	}
+
+	glDisable(GL_POLYGON_OFFSET_FILL);
+	glBindFramebuffer(GL_FRAMEBUFFER, previousFbo);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+void ShadowCascades::bind() const
+{
+	glBindTextureUnit(SHADOW_MAP_UNIT, shadowMaps);
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <functional>
+#include <cmath>
+#include <algorithm>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include "Frustum.h"
+#include "UBO.h"
+
+using namespace glm;
+using namespace std;
+
+//Uniform block binding and texture unit of the shadow maps, must match fragment.frag and terrainFragment.frag
+const GLuint SHADOW_BLOCK_BINDING = 2;
+const GLuint SHADOW_MAP_UNIT = 4;
+const int SHADOW_CASCADES = 3;
+
+struct ShadowSettings {
+	int resolution = 2048;			//texels along one side of a cascade
+	float distance = 300.0f;		//shadows end this far from the camera
+	float casterDistance = 1000.0f;	//casters this far towards the light from a cascade still shadow it
+	float splitLambda = 0.75f;		//0 = linear cascade splits, 1 = logarithmic
+};
+
+//layout(std140, binding = 2) uniform Shadows
+struct ShadowBlock {
+	mat4 lightMatrices[SHADOW_CASCADES];	//world to shadow map clip space
+	vec4 cascadeSplits;						//view depth where each cascade ends
+};
+
+static_assert(SHADOW_CASCADES <= 4, "cascade splits are packed into one vec4");
+
+//Cascaded shadow maps for one directional light. Every cascade keeps a cached depth map of
+//the static casters (terrain, buildings, trees) that is only redrawn when the cascade's
+//bounds, the light or the static scene change. Cascades are fitted to bounding spheres of
+//the view frustum slices and move in steps of a fraction of their size, so a walking camera
+//only refreshes a cascade now and then. Each frame the cache is copied into the shadow map
+//that is sampled and the dynamic casters are drawn on top of it.
+class ShadowCascades
+{
+public:
+	//draws the casters of one cascade, the light matrix is set by the callback on its shaders
+	typedef function<void(const mat4& lightMatrix, const Frustum& frustum)> DrawCasters;
+
+	ShadowCascades(const ShadowSettings& settings);
+	~ShadowCascades();
+
+	ShadowCascades(const ShadowCascades&) = delete;
+	ShadowCascades& operator=(const ShadowCascades&) = delete;
+
+	//fits the cascades to the camera, staticVersion must change whenever a static caster is added, moved or removed
+	void update(const mat4& view, float fovy, float aspect, float zNear, vec3 lightDirection, uint64_t staticVersion);
+
+	//drawStatic only runs for cascades whose cache is stale, drawDynamic runs for every cascade every frame
+	void render(const DrawCasters& drawStatic, const DrawCasters& drawDynamic);
+
+	//binds the shadow maps to SHADOW_MAP_UNIT for the lighting pass
+	void bind() const;
+
+	//cascades whose static cache was redrawn in the last render()
+	int getStaticRefreshCount() const { return staticRefreshes; }
+
+private:
+	struct Cascade {
+		mat4 lightMatrix;
+		vec3 center;		//light space, snapped
+		float halfSize;
+		bool stale;
+	};
+
+	ShadowSettings settings;
+	Cascade cascades[SHADOW_CASCADES];
+	vec3 lightDirection;
+	uint64_t staticVersion;
+	int staticRefreshes;
+
+	GLuint staticMaps, shadowMaps;		//depth array textures, a layer per cascade
+	GLuint fbo;
+	UBO block;
+
+	GLuint createMaps(bool compare);
+	void attachLayer(GLuint texture, int layer);
+};
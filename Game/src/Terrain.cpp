@@ -1,199 +1,478 @@
 #include "Terrain.h"
 
+//tiles uploaded per frame at most, the rest waits for the next frames
+const int TILE_UPLOADS_PER_FRAME = 4;
 
+//distance from p to the closest point of the box is within radius
+static bool intersectsSphere(vec3 minimum, vec3 maximum, vec3 p, float radius)
+{
+	vec3 d = p - glm::clamp(p, minimum, maximum);
+	return dot(d, d) <= radius * radius;
+}
 
+static void addQuad(vector<vec3>& triangles, vec3 a, vec3 b, vec3 c, vec3 d)
+{
+	vec3 quad[6] = { a, b, c, a, c, d };
+	triangles.insert(triangles.end(), quad, quad + 6);
+}
 
-const int TERRAIN_DEPTH = 10;
-const int TERRAIN_WIDTH = 10;
-
-
-//ripple displacement speed
-const float SPEED = 2;
+Terrain::Terrain(const TerrainSettings& settings)
+	: settings(settings), surface(settings.grassTexture.c_str(), settings.mountainTexture.c_str()),
+	physics(nullptr), layerCount(0), frame(0), residencyVersion(0), stopping(false)
+{
+	for (int level = 0; level < settings.lodLevels; level++)
+		ranges.push_back(settings.lodDistance * float(1 << level));
 
-/*ripple mesh vertices and indices
-glm::vec3 vertices[(NUM_X + 1) * (NUM_Z + 1)];
-const int TOTAL_INDICES = NUM_X * NUM_Z * 2 * 3;
-GLushort indices[TOTAL_INDICES];
-*/
+	openArchive();
+	createGrid();
+	glCreateBuffers(1, &chunkBuffer);
+	createTileTextures();
 
-//total vertices and indices in the terrain
-const int TOTAL = (TERRAIN_WIDTH * TERRAIN_DEPTH);
-const int TOTAL_INDICES = TOTAL * 2 * 3;
-const int TEX_COORDS = (TERRAIN_WIDTH * TERRAIN_DEPTH);
-glm::vec3 vertices[TOTAL];
-glm::vec3 normals[TOTAL_INDICES];
-glm::vec2 texCoords[TEX_COORDS];
-GLuint indices[TOTAL_INDICES];
+	streamThread = thread(&Terrain::stream, this);
+}
 
-//IDs
-GLuint vaoID;
-GLuint vboVerticesID;
-GLuint vboIndicesID;
-GLuint vboUVID;
+Terrain::~Terrain()
+{
+	{
+		lock_guard<mutex> lock(streamMutex);
+		stopping = true;
+	}
+	requestAvailable.notify_all();
+	streamThread.join();
+
+	detachPhysics();
+	glDeleteVertexArrays(1, &vao);
+	glDeleteBuffers(1, &vertexBuffer);
+	glDeleteBuffers(1, &indexBuffer);
+	glDeleteBuffers(1, &chunkBuffer);
+	glDeleteTextures(1, &heightTiles);
+	glDeleteTextures(1, &normalTiles);
+	glDeleteTextures(1, &splatTiles);
+}
 
+void Terrain::openArchive()
+{
+	//the archive is cut from the height map once and rebuilt when the map or the tiling changes
+	string path = settings.heightMap + ".tiles";
+	uint64_t hash = terrainArchiveHash(settings.heightMap, settings.size, settings.tileSize, settings.tileSamples, settings.heightScale);
+	archive.reset(new TerrainArchive(path, hash));
+	if (archive->isOpen() || !hash) return;
+
+	//the old archive has to let go of the file before it can be rewritten
+	archive.reset();
+	cout << "Terrain: cutting " << settings.heightMap << " into tiles" << endl;
+	HeightMap source(settings.heightMap.c_str(), false);
+	writeTerrainArchive(path, hash, source, settings.size, settings.tileSize, settings.tileSamples, settings.heightScale);
+	archive.reset(new TerrainArchive(path, hash));
+	if (!archive->isOpen()) cout << "ERROR: could not open terrain archive " << path << endl;
+}
 
+void Terrain::createGrid()
+{
+	//grid positions 0..gridSize, scaled and offset per chunk in the vertex shader
+	int n = settings.gridSize;
+	vector<vec2> vertices;
+	for (int z = 0; z <= n; z++)
+		for (int x = 0; x <= n; x++)
+			vertices.push_back(vec2(x, z));
+
+	//every quad is split along the same diagonal as its 2x2 block, so odd vertices that morph
+	//onto their lower neighbours turn the grid into the next coarser one exactly
+	vector<GLushort> indices;
+	for (int z = 0; z < n; z++) {
+		for (int x = 0; x < n; x++) {
+			GLushort a = GLushort(z * (n + 1) + x), b = GLushort(a + 1), c = GLushort(a + n + 1), d = GLushort(c + 1);
+			indices.insert(indices.end(), { a, c, d, a, d, b });
+		}
+	}
+	indexCount = GLsizei(indices.size());
+
+	glCreateBuffers(1, &vertexBuffer);
+	glNamedBufferData(vertexBuffer, vertices.size() * sizeof(vec2), vertices.data(), GL_STATIC_DRAW);
+	glCreateBuffers(1, &indexBuffer);
+	glNamedBufferData(indexBuffer, indices.size() * sizeof(GLushort), indices.data(), GL_STATIC_DRAW);
+
+	glCreateVertexArrays(1, &vao);
+	glVertexArrayVertexBuffer(vao, 0, vertexBuffer, 0, sizeof(vec2));
+	glEnableVertexArrayAttrib(vao, 0);
+	glVertexArrayAttribFormat(vao, 0, 2, GL_FLOAT, GL_FALSE, 0);
+	glVertexArrayAttribBinding(vao, 0, 0);
+	glVertexArrayElementBuffer(vao, indexBuffer);
+}
 
+void Terrain::createTileTextures()
+{
+	//one layer per resident tile, as many as the memory budget pays for
+	int s = archive->isOpen() ? int(archive->getHeader().tileSamples) : 2;
+	size_t samples = size_t(s) * s;
+	size_t tileBytes = samples * (sizeof(uint16_t) + 4 + 4)		//GPU: heights, normals, splat
+		+ samples * sizeof(float);								//CPU: heights for the collision shape
+	GLint maxLayers = 0;
+	glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+	layerCount = int(std::max<size_t>(1, size_t(settings.memoryBudget) * 1024 * 1024 / tileBytes));
+	layerCount = std::min(layerCount, int(maxLayers));
+
+	auto create = [this, s](GLuint& texture, GLenum format) {
+		glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &texture);
+		glTextureStorage3D(texture, 1, format, s, s, layerCount);
+		glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	};
+	create(heightTiles, GL_R16);
+	create(normalTiles, GL_RGBA8);
+	create(splatTiles, GL_RGBA8);
+
+	for (int layer = layerCount - 1; layer >= 0; layer--)
+		freeLayers.push_back(layer);
+}
 
-//setup plane geometry
-//setup plane vertices
-void Terrain::generateTerrain() {
-	//fill indices array
-	GLuint* id = &indices[0];
-	int i = 0, j = 0;
-	//setup vertices 
-	int count = 0;
-	//fill terrain vertices
-	for (i = 0; i < TERRAIN_DEPTH; i++) {
-		for (j = 0; j < TERRAIN_WIDTH; j++) {
-			vertices[count] = glm::vec3((float(j) / (TERRAIN_WIDTH - 1)), 0, (float(i) / (TERRAIN_DEPTH - 1)));
-			texCoords[count] = glm::vec2((float)i / TERRAIN_DEPTH, (float)j / TERRAIN_WIDTH);
 
-			count++;
-		}
-	}
-	//fill terrain indices
-	for (i = 0; i < TERRAIN_DEPTH - 1; i++) {
-		for (j = 0; j < TERRAIN_WIDTH - 1; j++) {
-			int i0 = j + i * TERRAIN_WIDTH;
-			int i1 = i0 + 1;
-			int i2 = i0 + TERRAIN_WIDTH;
-			int i3 = i2 + 1;
-			*id++ = i0;
-			*id++ = i2;
-			*id++ = i1;
-			*id++ = i1;
-			*id++ = i2;
-			*id++ = i3;
-			std::cout << i0 << std::endl;
-			std::cout << i1 << std::endl;
-			std::cout << i2 << std::endl;
-			std::cout << i3 << std::endl;
+//------------------------Streaming------------------------------------
+vector<int> Terrain::wantedTiles(vec3 viewPosition) const
+{
+	vector<int> wanted;
+	if (!archive->isOpen()) return wanted;
+
+	//tiles within streamDistance on the ground plane, nearest first
+	const TerrainArchiveHeader& header = archive->getHeader();
+	vec2 p(viewPosition.x, viewPosition.z);
+	vec2 origin(header.originX, header.originZ);
+	ivec2 low = glm::max(ivec2(floor((p - settings.streamDistance - origin) / header.tileSize)), ivec2(0));
+	ivec2 high = glm::min(ivec2(floor((p + settings.streamDistance - origin) / header.tileSize)), ivec2(header.tilesX - 1, header.tilesZ - 1));
+
+	vector<pair<float, int>> candidates;
+	for (int z = low.y; z <= high.y; z++) {
+		for (int x = low.x; x <= high.x; x++) {
+			vec2 corner = origin + vec2(x, z) * header.tileSize;
+			float distance = length(p - glm::clamp(p, corner, corner + header.tileSize));
+			if (distance <= settings.streamDistance) candidates.push_back(make_pair(distance, z * int(header.tilesX) + x));
 		}
 	}
+	sort(candidates.begin(), candidates.end());
+	if (candidates.size() > size_t(layerCount)) candidates.resize(layerCount);
 
-	
+	for (const auto& candidate : candidates) wanted.push_back(candidate.second);
+	return wanted;
+}
 
-	
+void Terrain::update(vec3 viewPosition)
+{
+	frame++;
+	vector<int> wanted = wantedTiles(viewPosition);
 
+	vector<unique_ptr<Tile>> collected;
+	bool requested;
+	{
+		//requests that weren't picked up yet are replaced by this frame's, nearest first
+		lock_guard<mutex> lock(streamMutex);
+		for (int key : requests) inFlight.erase(key);
+		requests.clear();
+
+		for (int key : wanted) {
+			auto resident = tiles.find(key);
+			if (resident != tiles.end()) resident->second->lastUsed = frame;
+			else if (inFlight.insert(key).second) requests.push_back(key);
+		}
 
-glGenVertexArrays(1, &vaoID);
-glGenBuffers(1, &vboVerticesID);
-glGenBuffers(1, &vboIndicesID);
-glGenBuffers(1, &vboUVID);
+		size_t count = std::min(loaded.size(), size_t(TILE_UPLOADS_PER_FRAME));
+		for (size_t i = 0; i < count; i++) {
+			inFlight.erase(loaded[i]->key);
+			collected.push_back(move(loaded[i]));
+		}
+		loaded.erase(loaded.begin(), loaded.begin() + count);
+		requested = !requests.empty();
+	}
+	if (requested) requestAvailable.notify_one();
 
-glBindVertexArray(vaoID);
+	for (unique_ptr<Tile>& tile : collected) {
+		tile->lastUsed = frame;
+		addTile(move(tile));
+	}
+}
 
-//Vertices
-glBindBuffer(GL_ARRAY_BUFFER, vboVerticesID);
-glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), &vertices[0], GL_STATIC_DRAW);
-glEnableVertexAttribArray(0);
+void Terrain::finish(vec3 viewPosition)
+{
+	vector<int> wanted = wantedTiles(viewPosition);
+	while (true) {
+		update(viewPosition);
+		bool complete = true;
+		for (int key : wanted) complete = complete && tiles.count(key) > 0;
+		if (complete) return;
+		this_thread::sleep_for(chrono::milliseconds(1));
+	}
+}
 
-//Indices
-glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vboIndicesID);
-glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), &indices[0], GL_STATIC_DRAW);
+void Terrain::stream()
+{
+	while (true) {
+		int key;
+		{
+			unique_lock<mutex> lock(streamMutex);
+			requestAvailable.wait(lock, [this]() { return stopping || !requests.empty(); });
+			if (stopping) return;
+			key = requests.front();
+			requests.pop_front();
+		}
 
-//UV
-glBindBuffer(GL_ARRAY_BUFFER, vboUVID);
-glBufferData(GL_ARRAY_BUFFER, TEX_COORDS * sizeof(glm::vec2), &texCoords[0], GL_STATIC_DRAW);
-glEnableVertexAttribArray(1);
-glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, 0);
+		unique_ptr<Tile> tile = loadTile(key);
+		lock_guard<mutex> lock(streamMutex);
+		loaded.push_back(move(tile));
+	}
 }
 
+unique_ptr<Terrain::Tile> Terrain::loadTile(int key)
+{
+	const TerrainArchiveHeader& header = archive->getHeader();
+	int x = key % int(header.tilesX), z = key / int(header.tilesX);
+
+	unique_ptr<Tile> tile(new Tile());
+	tile->key = key;
+	tile->layer = -1;
+	tile->lastUsed = 0;
+	tile->corner = vec2(header.originX, header.originZ) + vec2(x, z) * header.tileSize;
+	tile->entry = archive->getTile(x, z);
+	tile->shape = nullptr;
+	tile->body = nullptr;
+
+	//the reads start here instead of on the GL thread: normals and splat weights are prefetched
+	//while the heights are converted, they are uploaded straight from the mapping a frame later
+	archive->prefetchTile(*tile->entry);
+	size_t samples = size_t(header.tileSamples) * header.tileSamples;
+	const uint16_t* heights = archive->getHeights(*tile->entry);
+	tile->heights.resize(samples);
+	for (size_t i = 0; i < samples; i++) tile->heights[i] = heights[i] / 65535.0f;
+
+	tile->nodes.resize(1);
+	buildNode(*tile, 0, tile->corner, header.tileSize, settings.lodLevels - 1);
+	return tile;
+}
 
-
-//depth = rows
-//calculate normals
-/*void Terrain::generateNormals()
+void Terrain::buildNode(Tile& tile, int index, vec2 corner, float size, int level)
 {
-	std::vector<std::vector<glm::vec3>> _normals = std::vector<std::vector<glm::vec3>>(TERRAIN_DEPTH, std::vector<glm::vec3>(TERRAIN_WIDTH));
-	std::vector< std::vector<glm::vec3> > tempNormals[2];
-	for (auto i = 0; i < 2; i++) {
-		tempNormals[i] = std::vector<std::vector<glm::vec3>>(TERRAIN_DEPTH - 1, std::vector<glm::vec3>(TERRAIN_WIDTH - 1));
+	//height range of the samples under the node
+	const TerrainArchiveHeader& header = archive->getHeader();
+	int last = int(header.tileSamples) - 1;
+	float spacing = header.tileSize / last;
+	ivec2 low = glm::clamp(ivec2(floor((corner - tile.corner) / spacing)), ivec2(0), ivec2(last));
+	ivec2 high = glm::clamp(ivec2(ceil((corner + size - tile.corner) / spacing)), ivec2(0), ivec2(last));
+
+	float minimum = 1.0f, maximum = 0.0f;
+	for (int z = low.y; z <= high.y; z++) {
+		for (int x = low.x; x <= high.x; x++) {
+			float h = tile.heights[size_t(z) * header.tileSamples + x];
+			minimum = std::min(minimum, h);
+			maximum = std::max(maximum, h);
+		}
 	}
 
-	for (auto i = 0; i < TERRAIN_DEPTH - 1; i++)
-	{
-		for (auto j = 0; j < TERRAIN_WIDTH - 1; j++)
-		{
-			const auto& vertexA = vertices[j + i * TERRAIN_WIDTH]; //
-			const auto& vertexB = vertices[j + i * TERRAIN_WIDTH + 1];
-			const auto& vertexC = vertices[j + i * TERRAIN_WIDTH + TERRAIN_WIDTH];
-			const auto& vertexD = vertices[j + i * TERRAIN_WIDTH + TERRAIN_WIDTH + 1];
-			std::cout << "thisA " << vertexA.x << vertexA.y << vertexA.z<< std::endl;
-			std::cout << "thisb " << vertexB.x << vertexB.y << vertexB.z << std::endl;
-			std::cout << "thisc " << vertexC.x << vertexC.y << vertexC.z << std::endl;
-			std::cout << "thisd " << vertexD.x << vertexD.y << vertexD.z << std::endl;
-
-
+	Node node;
+	node.corner = corner;
+	node.size = size;
+	node.minHeight = (minimum - 0.5f) * header.heightScale;
+	node.maxHeight = (maximum - 0.5f) * header.heightScale;
+	node.level = level;
+	node.firstChild = -1;
+
+	//the four children get consecutive slots before any of them is filled
+	if (level > 0) {
+		node.firstChild = int(tile.nodes.size());
+		tile.nodes.resize(tile.nodes.size() + 4);
+	}
+	tile.nodes[index] = node;
 
+	float half = size * 0.5f;
+	for (int i = 0; level > 0 && i < 4; i++)
+		buildNode(tile, node.firstChild + i, corner + vec2(i & 1, i >> 1) * half, half, level - 1);
+}
 
+void Terrain::addTile(unique_ptr<Tile> tile)
+{
+	if (tiles.count(tile->key)) return;
+
+	if (freeLayers.empty()) {
+		//least recently wanted tile that isn't wanted this frame
+		Tile* oldest = nullptr;
+		for (auto& resident : tiles)
+			if (resident.second->lastUsed < frame && (!oldest || resident.second->lastUsed < oldest->lastUsed))
+				oldest = resident.second.get();
+		if (!oldest) return;		//every layer is in use, the tile is requested again later
+		evictTile(*oldest);
+	}
+	tile->layer = freeLayers.back();
+	freeLayers.pop_back();
+
+	int s = int(archive->getHeader().tileSamples);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTextureSubImage3D(heightTiles, 0, 0, 0, tile->layer, s, s, 1, GL_RED, GL_UNSIGNED_SHORT, archive->getHeights(*tile->entry));
+	glTextureSubImage3D(normalTiles, 0, 0, 0, tile->layer, s, s, 1, GL_RGBA, GL_UNSIGNED_BYTE, archive->getNormals(*tile->entry));
+	glTextureSubImage3D(splatTiles, 0, 0, 0, tile->layer, s, s, 1, GL_RGBA, GL_UNSIGNED_BYTE, archive->getSplat(*tile->entry));
+
+	attachBody(*tile);
+	int key = tile->key;
+	tiles[key] = move(tile);
+	residencyVersion++;
+}
 
-			const auto triangleNormalA = glm::cross(vertexA - vertexB, vertexA - vertexD);
-			const auto triangleNormalB = glm::cross(vertexD - vertexC, vertexC - vertexB);
+void Terrain::evictTile(Tile& tile)
+{
+	detachBody(tile);
+	freeLayers.push_back(tile.layer);
+	tiles.erase(tile.key);
+	residencyVersion++;
+}
 
-			tempNormals[0][i][j] = glm::normalize(triangleNormalA);
-			tempNormals[1][i][j] = glm::normalize(triangleNormalB);
 
-			std::cout << " tempnormals  "<< tempNormals[0][i][j].x << tempNormals[0][i][j].y << tempNormals[0][i][j].z << std::endl;
-		}
-	}
+//------------------------Physics------------------------------------
+void Terrain::attachPhysics(Physics* physics)
+{
+	this->physics = physics;
+	for (auto& resident : tiles) attachBody(*resident.second);
+}
 
-	for (auto i = 0; i < TERRAIN_DEPTH; i++)
-	{
-		for (auto j = 0; j < TERRAIN_WIDTH; j++)
-		{
-			const auto isFirstRow = i == 0;
-			const auto isFirstColumn = j == 0;
-			const auto isLastRow = i == TERRAIN_DEPTH - 1;
-			const auto isLastColumn = j == TERRAIN_WIDTH - 1;
+void Terrain::detachPhysics()
+{
+	for (auto& resident : tiles) detachBody(*resident.second);
+	physics = nullptr;
+}
 
-			auto finalVertexNormal = glm::vec3(0.0f, 0.0f, 0.0f);
+void Terrain::attachBody(Tile& tile)
+{
+	if (!physics || tile.body) return;
+
+	//heights stay in [0, 1] and are scaled by the local scaling like the rest of the grid,
+	//bullet centers the field on (min + max) / 2, which is the 0.5 the renderer subtracts
+	const TerrainArchiveHeader& header = archive->getHeader();
+	int s = int(header.tileSamples);
+	float spacing = header.tileSize / (s - 1);
+	tile.shape = new btHeightfieldTerrainShape(s, s, tile.heights.data(), 1.0f, 0.0f, 1.0f, 1, PHY_FLOAT, false);
+	tile.shape->setLocalScaling(btVector3(spacing, header.heightScale, spacing));
+
+	btTransform t;
+	t.setIdentity();
+	vec2 center = tile.corner + header.tileSize * 0.5f;
+	t.setOrigin(btVector3(center.x, 0, center.y));
+	btRigidBody::btRigidBodyConstructionInfo info(0.0, new btDefaultMotionState(t), tile.shape);
+	tile.body = new btRigidBody(info);
+	physics->addStaticBody(tile.body);
+}
 
-			// Look for triangle to the upper-lef
-			if (!isFirstRow && !isFirstColumn) {
-				finalVertexNormal += tempNormals[0][i - 1][j - 1];
-			}
+void Terrain::detachBody(Tile& tile)
+{
+	if (!tile.body) return;
+	physics->removeStaticBody(tile.body);
+	delete tile.body->getMotionState();
+	delete tile.body;
+	delete tile.shape;
+	tile.body = nullptr;
+	tile.shape = nullptr;
+}
 
-			// Look for triangles to the upper-righ
-			if (!isFirstRow && !isLastColumn) {
-				for (auto k = 0; k < 2; k++) {
-					finalVertexNormal += tempNormals[k][i - 1][j];
-				}
-			}
 
-			// Look for triangle to the bottom-righ
-			if (!isLastRow && !isLastColumn) {
-				finalVertexNormal += tempNormals[0][i][j];
-			}
+//------------------------Rendering------------------------------------
+void Terrain::select(vec3 viewPosition, const Frustum& frustum)
+{
+	chunks.clear();
+	for (auto& resident : tiles)
+		selectNode(*resident.second, 0, viewPosition, frustum);
+}
 
-			// Look for triangles to the bottom-righ
-			if (!isLastRow && !isFirstColumn) {
-				for (auto k = 0; k < 2; k++) {
-					finalVertexNormal += tempNormals[k][i][j - 1];
-				}
-			}
+//returns false if the node is out of its level's range, the parent then covers it
+bool Terrain::selectNode(const Tile& tile, int index, vec3 viewPosition, const Frustum& frustum)
+{
+	const Node& node = tile.nodes[index];
+	vec3 minimum(node.corner.x, node.minHeight, node.corner.y);
+	vec3 maximum(node.corner.x + node.size, node.maxHeight, node.corner.y + node.size);
 
-			// Store final normal of j-th vertex in i-th ro
-			_normals[i][j] = glm::normalize(finalVertexNormal);
-			std::cout << "hey " << finalVertexNormal.x << " - " << finalVertexNormal.y <<" - "<< finalVertexNormal.z<< std::endl;
-		
+	if (!intersectsSphere(minimum, maximum, viewPosition, ranges[node.level])) return false;
+	if (!frustum.intersects(minimum, maximum)) return true;		//handled, nothing to draw
 
-		}
-		//_vbo.addData(_normals[i].data(), TERRAIN_WIDTH * sizeof(glm::vec3));      //still need to figure this out
+	if (node.level == 0 || !intersectsSphere(minimum, maximum, viewPosition, ranges[node.level - 1])) {
+		addChunk(tile, node);
+		return true;
 	}
-	for (size_t i = 0; i < sizeof(normals); i++)
-	{
-		std::cout << normals[i].x << normals[i].y << normals[i].z << std::endl;
 
+	for (int i = 0; i < 4; i++) {
+		const Node& child = tile.nodes[node.firstChild + i];
+		//beyond the finer range: the child's grid fully morphed has this node's resolution
+		if (!selectNode(tile, node.firstChild + i, viewPosition, frustum)) {
+			vec3 childMin(child.corner.x, child.minHeight, child.corner.y);
+			vec3 childMax(child.corner.x + child.size, child.maxHeight, child.corner.y + child.size);
+			if (frustum.intersects(childMin, childMax)) addChunk(tile, child);
+		}
 	}
-}*/
+	return true;
+}
 
-void Terrain::drawTerrain()
+void Terrain::addChunk(const Tile& tile, const Node& node)
 {
+	int level = node.level;
+	float end = ranges[level];
+	float start = glm::mix(level > 0 ? ranges[level - 1] : 0.0f, end, settings.morphStart);
+
+	TerrainChunk chunk;
+	chunk.offsetSize = vec4(node.corner.x, node.corner.y, node.size, float(tile.layer));
+	chunk.morph = vec4(start, end, tile.corner.x, tile.corner.y);
+	chunks.push_back(chunk);
+}
 
-	glBindVertexArray(vaoID);
-	glDrawElements(GL_TRIANGLES, TOTAL_INDICES, GL_UNSIGNED_INT, 0);
+void Terrain::draw(Shader& shader)
+{
+	if (chunks.empty()) return;
+
+	glNamedBufferData(chunkBuffer, chunks.size() * sizeof(TerrainChunk), chunks.data(), GL_STREAM_DRAW);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TERRAIN_CHUNK_BINDING, chunkBuffer);
+
+	const TerrainArchiveHeader& header = archive->getHeader();
+	shader.use();
+	shader.setInt("heightTiles", 0);
+	shader.setInt("normalTiles", 1);
+	shader.setInt("splatTiles", 2);
+	shader.setFloat("tileSize", header.tileSize);
+	shader.setFloat("tileSamples", float(header.tileSamples));
+	shader.setFloat("scale", header.heightScale);
+	shader.setFloat("half_scale", header.heightScale * 0.5f);
+	shader.setFloat("gridSize", float(settings.gridSize));
+	shader.setFloat("textureTiling", settings.textureTiling);
+
+	glBindTextureUnit(0, heightTiles);
+	glBindTextureUnit(1, normalTiles);
+	glBindTextureUnit(2, splatTiles);
+	surface.doubleBind();
+	glActiveTexture(GL_TEXTURE0);
+
+	glBindVertexArray(vao);
+	glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_SHORT, 0, GLsizei(chunks.size()));
+	glBindVertexArray(0);
+}
 
+void Terrain::getOccluders(vec3 viewPosition, float distance, int level, vector<vec3>& triangles) const
+{
+	//no sample of a cell is lower than its minimum, so the step and the walls beneath its edges
+	//stay inside the ground and can only hide what the ground hides
+	level = glm::clamp(level, 0, settings.lodLevels - 1);
+	for (const auto& resident : tiles) {
+		const Tile& tile = *resident.second;
+		float bottom = tile.nodes[0].minHeight;
+		for (const Node& node : tile.nodes) {
+			vec3 minimum(node.corner.x, node.minHeight, node.corner.y);
+			vec3 maximum(node.corner.x + node.size, node.maxHeight, node.corner.y + node.size);
+			if (node.level != level || !intersectsSphere(minimum, maximum, viewPosition, distance)) continue;
+
+			float h = node.minHeight;
+			vec3 corners[4] = { vec3(minimum.x, h, minimum.z), vec3(maximum.x, h, minimum.z), vec3(maximum.x, h, maximum.z), vec3(minimum.x, h, maximum.z) };
+			addQuad(triangles, corners[0], corners[1], corners[2], corners[3]);
+			if (h - bottom < 0.01f) continue;
+			for (int i = 0; i < 4; i++) {
+				vec3 a = corners[i], b = corners[(i + 1) % 4];
+				addQuad(triangles, a, b, vec3(b.x, bottom, b.z), vec3(a.x, bottom, a.z));
+			}
+		}
+	}
+}
 
-}
\ No newline at end of file
+float Terrain::getHeight(float x, float z) const
+{
+	return archive->isOpen() ? archive->getHeight(x, z) : 0.0f;
+}
@@ -1,29 +1,156 @@
 #pragma once
 
-#include <sstream>
 #include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include <iostream>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
-#include "Utils.h"
+#include <glm/glm.hpp>
 #include "Shader.h"
-#include "VAO.h"
-#include "VBO.h"
-#include "EBO.h"
 #include "Texture.h"
-#include "Camera.h"
-#include "Model.h"
-#include <glm/glm.hpp>
-#include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtc/type_ptr.hpp>
-#include <glm/gtx/string_cast.hpp>
+#include "HeightMap.h"
+#include "TerrainArchive.h"
+#include "Frustum.h"
+#include "Physics.h"
+#include "btBulletCollisionCommon.h"
+#include "BulletCollision/CollisionShapes/btHeightfieldTerrainShape.h"
+
+using namespace glm;
+using namespace std;
+
+//Binding point of the selected chunks storage buffer (Chunks block in terrainVertex.vert)
+const GLuint TERRAIN_CHUNK_BINDING = 1;
+
+struct TerrainSettings {
+	string heightMap = "assets/textures/terrain/heightMap1.jpg";	//cut into <heightMap>.tiles on first use
+	string grassTexture = "assets/textures/terrain/grass3.jpg";
+	string mountainTexture = "assets/textures/terrain/mountain.jpg";
+	float size = 2048.0f;			//world units covered by the height map along x and z, centered on the origin
+	float heightScale = 150.0f;		//height difference between black and white, heights are centered on 0
+	float textureTiling = 0.05f;	//surface texture repeats per world unit
+	float tileSize = 256.0f;		//world units along one side of a streamed tile
+	int tileSamples = 129;			//height samples along one side of a tile, including the shared border
+	int gridSize = 16;				//quads along one side of a chunk, even
+	int lodLevels = 4;				//quadtree depth per tile, leaf chunks are tileSize / 2^(lodLevels - 1) wide
+	float lodDistance = 256.0f;		//range of the finest level, doubles with every level
+	float morphStart = 0.7f;		//where in its range a level starts to morph into the next coarser one
+	float streamDistance = 2048.0f;	//tiles closer than this to the camera are paged in
+	int memoryBudget = 64;			//MB for resident tiles, CPU and GPU copies together
+};
 
+//One selected chunk as the vertex shader reads it (std430)
+struct TerrainChunk {
+	vec4 offsetSize;	//x, z of the chunk corner, chunk size, texture layer of its tile
+	vec4 morph;			//camera distance where morphing starts and where it is complete, tile corner x, z
+};
 
+
+//Streamed CDLOD terrain (Strugar 2010). The height map is cut once into a memory-mapped
+//archive of tiles; tiles around the camera are read by a background thread and kept in an
+//LRU cache of texture array layers whose count follows the memory budget, so memory stays
+//flat however large the world is. Every resident tile has a quadtree of chunks, picked per
+//frame by distance ranges that double per level and by the view frustum; vertices morph
+//into the next coarser grid before a level ends so there are no cracks or pops. All chunks
+//are drawn with a single instanced draw, resident tiles also get a heightfield body.
 class Terrain
 {
 public:
-	void generateTerrain();
-	void generateNormals();
-	void drawTerrain();
+	Terrain(const TerrainSettings& settings);
+	~Terrain();
+
+	Terrain(const Terrain&) = delete;
+	Terrain& operator=(const Terrain&) = delete;
+
+	//pages tiles in and out around the camera and uploads loaded ones, GL thread, once per frame
+	void update(vec3 viewPosition);
+	//blocks until every tile update() wants around the camera is resident
+	void finish(vec3 viewPosition);
+
+	//picks the chunks to draw from the camera position
+	void select(vec3 viewPosition, const Frustum& frustum);
+	void draw(Shader& shader);
+
+	//world space triangles that lie below the height samples of the resident tiles, for the OcclusionCuller:
+	//the cells of one quadtree level within distance as steps at their lowest height, with walls down to the tile's lowest
+	void getOccluders(vec3 viewPosition, float distance, int level, vector<vec3>& triangles) const;
+
+	//resident tiles keep a heightfield body in the world, detach before the physics world is deleted
+	void attachPhysics(Physics* physics);
+	void detachPhysics();
+
+	//terrain height in world units below (x, z), also for tiles that aren't resident
+	float getHeight(float x, float z) const;
+	size_t getChunkCount() const { return chunks.size(); }
+	size_t getResidentTileCount() const { return tiles.size(); }
+	//changes whenever a tile is paged in or out, e.g. to refresh cached shadows
+	uint64_t getResidencyVersion() const { return residencyVersion; }
+	const TerrainSettings& getSettings() const { return settings; }
+
+private:
+	struct Node {
+		vec2 corner;			//minimum x, z
+		float size;
+		float minHeight, maxHeight;
+		int level;				//0 = leaf
+		int firstChild;			//the four children are consecutive, -1 for leaves
+	};
+
+	struct Tile {
+		int key;				//z * tilesX + x
+		int layer;				//slot in the tile texture arrays
+		uint64_t lastUsed;		//frame the tile was last wanted
+		vec2 corner;
+		vector<float> heights;	//[0, 1], read in place by the collision shape
+		vector<Node> nodes;
+		const TerrainTileEntry* entry;
+		btHeightfieldTerrainShape* shape;
+		btRigidBody* body;
+	};
+
+	TerrainSettings settings;
+	unique_ptr<TerrainArchive> archive;
+	Texture surface;			//grass and mountain, units 10 and 11
+	vector<float> ranges;		//lod range per level
+	vector<TerrainChunk> chunks;
+	Physics* physics;
+
+	unordered_map<int, unique_ptr<Tile>> tiles;		//resident, by key
+	vector<int> freeLayers;
+	int layerCount;
+	uint64_t frame;
+	uint64_t residencyVersion;
+
+	//background loading: the main thread queues keys, the stream thread returns filled tiles
+	thread streamThread;
+	deque<int> requests;
+	unordered_set<int> inFlight;					//requested or loaded but not yet collected
+	vector<unique_ptr<Tile>> loaded;
+	mutex streamMutex;
+	condition_variable requestAvailable;
+	bool stopping;
+
+	GLuint vao, vertexBuffer, indexBuffer, chunkBuffer;
+	GLuint heightTiles, normalTiles, splatTiles;
+	GLsizei indexCount;
 
-};
\ No newline at end of file
+	void openArchive();
+	void createGrid();
+	void createTileTextures();
+	void stream();
+	unique_ptr<Tile> loadTile(int key);
+	void buildNode(Tile& tile, int index, vec2 corner, float size, int level);
+	void addTile(unique_ptr<Tile> tile);
+	void evictTile(Tile& tile);
+	void attachBody(Tile& tile);
+	void detachBody(Tile& tile);
+	vector<int> wantedTiles(vec3 viewPosition) const;
+	bool selectNode(const Tile& tile, int index, vec3 viewPosition, const Frustum& frustum);
+	void addChunk(const Tile& tile, const Node& node);
+};
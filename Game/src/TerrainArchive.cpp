@@ -0,0 +1,187 @@
+#include "TerrainArchive.h"
+#include "Hash.h"
+
+static size_t align4(size_t size)
+{
+	return (size + 3) & ~size_t(3);
+}
+
+TerrainArchive::TerrainArchive(const string& path, uint64_t sourceHash)
+	: header(nullptr), entries(nullptr)
+{
+	//the mapping is only kept when the archive is valid, a rejected file can be rewritten right away
+	shared_ptr<MappedFile> mapped = make_shared<MappedFile>(path);
+	if (!mapped->isOpen() || mapped->getSize() < sizeof(TerrainArchiveHeader)) return;
+
+	const TerrainArchiveHeader* h = reinterpret_cast<const TerrainArchiveHeader*>(mapped->getData());
+	if (memcmp(h->magic, "TRN0", 4) != 0 || h->version != TERRAIN_ARCHIVE_VERSION || h->sourceHash != sourceHash) return;
+
+	size_t tileCount = size_t(h->tilesX) * h->tilesZ;
+	size_t directoryEnd = sizeof(TerrainArchiveHeader) + tileCount * sizeof(TerrainTileEntry);
+	if (mapped->getSize() < directoryEnd) return;
+
+	//every tile has to lie inside the file before anything is read from it
+	const TerrainTileEntry* e = reinterpret_cast<const TerrainTileEntry*>(mapped->getData() + sizeof(TerrainArchiveHeader));
+	header = h;
+	for (size_t i = 0; i < tileCount; i++) {
+		if (e[i].offset < directoryEnd || e[i].offset + getTileBytes() > mapped->getSize()) {
+			header = nullptr;
+			return;
+		}
+	}
+	entries = e;
+	file = mapped;
+}
+
+const TerrainTileEntry* TerrainArchive::getTile(int x, int z) const
+{
+	if (x < 0 || z < 0 || x >= int(header->tilesX) || z >= int(header->tilesZ)) return nullptr;
+	return &entries[size_t(z) * header->tilesX + x];
+}
+
+size_t TerrainArchive::getTileBytes() const
+{
+	size_t samples = size_t(header->tileSamples) * header->tileSamples;
+	return align4(samples * sizeof(uint16_t)) + samples * 4 + samples * 4;
+}
+
+const uint16_t* TerrainArchive::getHeights(const TerrainTileEntry& tile) const
+{
+	return reinterpret_cast<const uint16_t*>(file->getData() + tile.offset);
+}
+
+const uint8_t* TerrainArchive::getNormals(const TerrainTileEntry& tile) const
+{
+	size_t samples = size_t(header->tileSamples) * header->tileSamples;
+	return file->getData() + tile.offset + align4(samples * sizeof(uint16_t));
+}
+
+const uint8_t* TerrainArchive::getSplat(const TerrainTileEntry& tile) const
+{
+	size_t samples = size_t(header->tileSamples) * header->tileSamples;
+	return getNormals(tile) + samples * 4;
+}
+
+void TerrainArchive::prefetchTile(const TerrainTileEntry& tile) const
+{
+	file->prefetch(tile.offset, getTileBytes());
+}
+
+float TerrainArchive::getHeight(float x, float z) const
+{
+	vec2 p = (vec2(x, z) - vec2(header->originX, header->originZ)) / header->tileSize;
+	const TerrainTileEntry* tile = getTile(int(floor(p.x)), int(floor(p.y)));
+	if (!tile) return 0.0f;
+
+	//sample position inside the tile
+	int last = int(header->tileSamples) - 1;
+	vec2 s = (p - floor(p)) * float(last);
+	int sx = glm::min(int(s.x), last - 1), sz = glm::min(int(s.y), last - 1);
+	vec2 f = s - vec2(sx, sz);
+
+	const uint16_t* heights = getHeights(*tile);
+	auto at = [heights, this](int i, int j) { return heights[size_t(j) * header->tileSamples + i] / 65535.0f; };
+	float h = mix(mix(at(sx, sz), at(sx + 1, sz), f.x), mix(at(sx, sz + 1), at(sx + 1, sz + 1), f.x), f.y);
+	return (h - 0.5f) * header->heightScale;
+}
+
+
+uint64_t terrainArchiveHash(const string& heightMapPath, float worldSize, float tileSize, int tileSamples, float heightScale)
+{
+	MappedFile source(heightMapPath);
+	if (!source.isOpen()) return 0;
+
+	uint64_t hash = hashBytes(source.getData(), source.getSize());
+	float parameters[4] = { worldSize, tileSize, float(tileSamples), heightScale };
+	return hashBytes(parameters, sizeof(parameters), hash);
+}
+
+//rock on steep slopes and low ground, grass elsewhere, matching the old height bands of the terrain shader
+static float rockWeight(float height, vec3 normal)
+{
+	float band = height >= -30.0f ? 0.1f : height >= -45.0f ? 0.3f : height >= -60.0f ? 0.6f : 0.9f;
+	float slope = glm::clamp((0.85f - normal.y) / 0.25f, 0.0f, 1.0f);
+	return std::max(band, slope);
+}
+
+bool writeTerrainArchive(const string& path, uint64_t sourceHash, const HeightMap& heightMap, float worldSize, float tileSize, int tileSamples, float heightScale)
+{
+	ofstream out(path, ios::binary);
+	if (!out.is_open()) {
+		cout << "ERROR: could not write terrain archive " << path << endl;
+		return false;
+	}
+
+	TerrainArchiveHeader header;
+	memcpy(header.magic, "TRN0", 4);
+	header.version = TERRAIN_ARCHIVE_VERSION;
+	header.sourceHash = sourceHash;
+	header.tilesX = header.tilesZ = uint32_t(std::max(1.0f, ceil(worldSize / tileSize)));
+	header.tileSamples = uint32_t(tileSamples);
+	header.tileSize = tileSize;
+	header.originX = header.originZ = -worldSize * 0.5f;
+	header.heightScale = heightScale;
+	header.padding = 0;
+
+	size_t tileCount = size_t(header.tilesX) * header.tilesZ;
+	size_t samples = size_t(tileSamples) * tileSamples;
+	size_t heightBytes = align4(samples * sizeof(uint16_t));
+	size_t tileBytes = heightBytes + samples * 8;
+	uint64_t dataStart = sizeof(TerrainArchiveHeader) + tileCount * sizeof(TerrainTileEntry);
+
+	//heights in [0, 1] over world positions, samples outside the map repeat its border
+	float spacing = tileSize / (tileSamples - 1);
+	auto heightAt = [&](vec2 p) { return heightMap.sample(p / worldSize + 0.5f); };
+
+	vector<TerrainTileEntry> entries(tileCount);
+	vector<uint16_t> heights(samples);
+	vector<uint8_t> normals(samples * 4), splat(samples * 4);
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(TerrainTileEntry));
+
+	for (uint32_t tz = 0; tz < header.tilesZ; tz++) {
+		for (uint32_t tx = 0; tx < header.tilesX; tx++) {
+			TerrainTileEntry& entry = entries[size_t(tz) * header.tilesX + tx];
+			entry.offset = dataStart + (size_t(tz) * header.tilesX + tx) * tileBytes;
+			entry.minHeight = heightScale;
+			entry.maxHeight = -heightScale;
+
+			vec2 origin = vec2(header.originX + tx * tileSize, header.originZ + tz * tileSize);
+			for (int z = 0; z < tileSamples; z++) {
+				for (int x = 0; x < tileSamples; x++) {
+					size_t i = size_t(z) * tileSamples + x;
+					vec2 p = origin + vec2(x, z) * spacing;
+					float h = heightAt(p);
+					heights[i] = uint16_t(glm::clamp(h, 0.0f, 1.0f) * 65535.0f + 0.5f);
+					float world = (heights[i] / 65535.0f - 0.5f) * heightScale;
+					entry.minHeight = std::min(entry.minHeight, world);
+					entry.maxHeight = std::max(entry.maxHeight, world);
+
+					//central differences over world positions, so shared borders get the same normal in both tiles
+					float dx = (heightAt(p + vec2(spacing, 0.0f)) - heightAt(p - vec2(spacing, 0.0f))) * heightScale;
+					float dz = (heightAt(p + vec2(0.0f, spacing)) - heightAt(p - vec2(0.0f, spacing))) * heightScale;
+					vec3 normal = normalize(vec3(-dx, 2.0f * spacing, -dz));
+					for (int c = 0; c < 3; c++) normals[i * 4 + c] = uint8_t((normal[c] * 0.5f + 0.5f) * 255.0f + 0.5f);
+					normals[i * 4 + 3] = 255;
+
+					float rock = rockWeight(world, normal);
+					splat[i * 4 + 0] = uint8_t((1.0f - rock) * 255.0f + 0.5f);
+					splat[i * 4 + 1] = uint8_t(rock * 255.0f + 0.5f);
+					splat[i * 4 + 2] = 0;
+					splat[i * 4 + 3] = 0;
+				}
+			}
+
+			const char padding[4] = { 0, 0, 0, 0 };
+			out.write(reinterpret_cast<const char*>(heights.data()), samples * sizeof(uint16_t));
+			out.write(padding, heightBytes - samples * sizeof(uint16_t));
+			out.write(reinterpret_cast<const char*>(normals.data()), normals.size());
+			out.write(reinterpret_cast<const char*>(splat.data()), splat.size());
+		}
+	}
+
+	//the directory is known once all tiles are done
+	out.seekp(sizeof(TerrainArchiveHeader));
+	out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(TerrainTileEntry));
+	return out.good();
+}
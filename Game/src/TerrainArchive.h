@@ -0,0 +1,78 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include "HeightMap.h"
+#include "MappedFile.h"
+
+using namespace glm;
+using namespace std;
+
+//Terrain archives hold the height map cut into square tiles that are paged in one at a time,
+//everything a tile needs is stored as it is uploaded. Layout (4 byte aligned, little endian):
+//	TerrainArchiveHeader
+//	tilesX * tilesZ x TerrainTileEntry		rows along +z
+//	per tile: heights (uint16), normals (RGBA8), splat weights (RGBA8), tileSamples^2 each
+//Neighbouring tiles repeat their shared border samples, so every tile renders and collides on its own.
+const uint32_t TERRAIN_ARCHIVE_VERSION = 2;		//2: height map rows no longer mirrored along z
+
+struct TerrainArchiveHeader {
+	char magic[4];			//"TRN0"
+	uint32_t version;
+	uint64_t sourceHash;	//height map file and the settings the tiles were cut with
+	uint32_t tilesX, tilesZ;
+	uint32_t tileSamples;	//samples along one side of a tile, including both borders
+	float tileSize;			//world units
+	float originX, originZ;	//world position of the corner of tile 0, 0
+	float heightScale;		//heights are (sample / 65535 - 0.5) * heightScale
+	uint32_t padding;
+};
+
+struct TerrainTileEntry {
+	uint64_t offset;			//start of the tile data in the file
+	float minHeight, maxHeight;	//world units
+};
+
+
+//Read-only access to a mapped terrain archive
+class TerrainArchive
+{
+public:
+	//fails (isOpen false) if the file is missing, damaged or was cut from a different source
+	TerrainArchive(const string& path, uint64_t sourceHash);
+
+	bool isOpen() const { return header != nullptr; }
+	const TerrainArchiveHeader& getHeader() const { return *header; }
+
+	//nullptr outside the archive
+	const TerrainTileEntry* getTile(int x, int z) const;
+	const uint16_t* getHeights(const TerrainTileEntry& tile) const;
+	const uint8_t* getNormals(const TerrainTileEntry& tile) const;
+	const uint8_t* getSplat(const TerrainTileEntry& tile) const;
+
+	//bytes of one tile's data in the file
+	size_t getTileBytes() const;
+	//starts reading a tile's data from disk ahead of its use, see MappedFile::prefetch
+	void prefetchTile(const TerrainTileEntry& tile) const;
+
+	//bilinear world height at (x, z), 0 outside the archive
+	float getHeight(float x, float z) const;
+
+private:
+	shared_ptr<MappedFile> file;
+	const TerrainArchiveHeader* header;
+	const TerrainTileEntry* entries;
+};
+
+//hash of the height map file and the tiling parameters, a changed value rebuilds the archive
+uint64_t terrainArchiveHash(const string& heightMapPath, float worldSize, float tileSize, int tileSamples, float heightScale);
+
+//cuts the height map, which covers worldSize x worldSize centered on the origin, into tiles
+//and computes normals and splat weights (r grass, g rock) for every sample
+bool writeTerrainArchive(const string& path, uint64_t sourceHash, const HeightMap& heightMap, float worldSize, float tileSize, int tileSamples, float heightScale);
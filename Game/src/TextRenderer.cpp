@@ -0,0 +1,100 @@
+#include "TextRenderer.h"
+
+TextRenderer::TextRenderer(Font& font)
+	: font(font), layoutCount(0), changed(false)
+{
+	glCreateBuffers(1, &vertexBuffer);
+	glCreateVertexArrays(1, &vao);
+	glVertexArrayVertexBuffer(vao, 0, vertexBuffer, 0, sizeof(TextVertex));
+	glEnableVertexArrayAttrib(vao, 0);
+	glVertexArrayAttribFormat(vao, 0, 2, GL_FLOAT, GL_FALSE, offsetof(TextVertex, position));
+	glVertexArrayAttribBinding(vao, 0, 0);
+	glEnableVertexArrayAttrib(vao, 1);
+	glVertexArrayAttribFormat(vao, 1, 2, GL_FLOAT, GL_FALSE, offsetof(TextVertex, texel));
+	glVertexArrayAttribBinding(vao, 1, 0);
+	glEnableVertexArrayAttrib(vao, 2);
+	glVertexArrayAttribFormat(vao, 2, 4, GL_FLOAT, GL_FALSE, offsetof(TextVertex, color));
+	glVertexArrayAttribBinding(vao, 2, 0);
+}
+
+TextRenderer::~TextRenderer()
+{
+	glDeleteVertexArrays(1, &vao);
+	glDeleteBuffers(1, &vertexBuffer);
+}
+
+void TextRenderer::add(const string& text, float x, float y, float scale, vec3 color)
+{
+	if (layoutCount == layouts.size()) layouts.push_back({ "", vec2(0.0f), 0.0f, vec3(0.0f), {} });
+	TextLayout& cached = layouts[layoutCount++];
+	if (cached.text == text && cached.position == vec2(x, y) && cached.scale == scale && cached.color == color) return;
+
+	cached.text = text;
+	cached.position = vec2(x, y);
+	cached.scale = scale;
+	cached.color = color;
+	layout(cached);
+	changed = true;
+}
+
+void TextRenderer::layout(TextLayout& text)
+{
+	text.vertices.clear();
+	vec4 c(text.color, 1.0f);
+	float x = text.position.x, y = text.position.y, scale = text.scale;
+	size_t i = 0;
+	while (i < text.text.size()) {
+		const Glyph& glyph = font.getGlyph(nextCodepoint(text.text, i));
+
+		if (glyph.size.x > 0) {
+			float xpos = x + glyph.bearing.x * scale;
+			float ypos = y - (glyph.size.y - glyph.bearing.y) * scale;
+			float w = glyph.size.x * scale;
+			float h = glyph.size.y * scale;
+
+			//the top row of the bitmap is at the glyph position in the atlas
+			vec2 t0 = vec2(glyph.position);
+			vec2 t1 = vec2(glyph.position + glyph.size);
+			TextVertex quad[6] = {
+				{ vec2(xpos,     ypos + h), vec2(t0.x, t0.y), c },
+				{ vec2(xpos,     ypos),     vec2(t0.x, t1.y), c },
+				{ vec2(xpos + w, ypos),     vec2(t1.x, t1.y), c },
+
+				{ vec2(xpos,     ypos + h), vec2(t0.x, t0.y), c },
+				{ vec2(xpos + w, ypos),     vec2(t1.x, t1.y), c },
+				{ vec2(xpos + w, ypos + h), vec2(t1.x, t0.y), c }
+			};
+			text.vertices.insert(text.vertices.end(), quad, quad + 6);
+		}
+		x += glyph.advance * scale;
+	}
+}
+
+void TextRenderer::draw(Shader& textShader)
+{
+	//text that wasn't added again this frame is gone
+	if (layoutCount < layouts.size()) {
+		layouts.resize(layoutCount);
+		changed = true;
+	}
+	layoutCount = 0;
+
+	if (changed) {
+		vertices.clear();
+		for (const TextLayout& text : layouts)
+			vertices.insert(vertices.end(), text.vertices.begin(), text.vertices.end());
+		glNamedBufferData(vertexBuffer, vertices.size() * sizeof(TextVertex), vertices.data(), GL_DYNAMIC_DRAW);
+		changed = false;
+	}
+	if (vertices.empty()) return;
+
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	textShader.use();
+	textShader.setInt("text", 0);
+	glBindTextureUnit(0, font.getTexture());
+
+	glBindVertexArray(vao);
+	glDrawArrays(GL_TRIANGLES, 0, GLsizei(vertices.size()));
+	glBindVertexArray(0);
+}
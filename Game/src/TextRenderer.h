@@ -0,0 +1,54 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "Font.h"
+#include "Shader.h"
+
+using namespace glm;
+using namespace std;
+
+struct TextVertex {
+	vec2 position;		//screen pixels
+	vec2 texel;			//atlas texels, the shader divides by the atlas size
+	vec4 color;
+};
+
+//Collects the text of a frame into one vertex buffer and draws all of it with a single call.
+//The n-th add() of a frame is compared with the n-th add() of the last frame, only text that
+//changed is laid out again and the vertex buffer is only uploaded when something changed.
+class TextRenderer
+{
+public:
+	TextRenderer(Font& font);
+	~TextRenderer();
+
+	TextRenderer(const TextRenderer&) = delete;
+	TextRenderer& operator=(const TextRenderer&) = delete;
+
+	//UTF-8 text with its baseline starting at (x, y), scale 1 draws the font at its pixel size
+	void add(const string& text, float x, float y, float scale, vec3 color);
+
+	//draws everything added since the last call, the shader's projection is set by the caller
+	void draw(Shader& textShader);
+
+private:
+	//one add() call and its laid out quads
+	struct TextLayout {
+		string text;
+		vec2 position;
+		float scale;
+		vec3 color;
+		vector<TextVertex> vertices;
+	};
+
+	Font& font;
+	vector<TextLayout> layouts;
+	size_t layoutCount;		//layouts added this frame
+	bool changed;
+	vector<TextVertex> vertices;
+	GLuint vao, vertexBuffer;
+
+	void layout(TextLayout& text);
+};
@@ -4,6 +4,7 @@
 #include "GLFW/glfw3.h"
 #include "stb_image.h"
 
+//2D texture loaded through the TextureCache
 class Texture
 {
 public:
@@ -11,12 +12,15 @@ public:
 	~Texture();
 	Texture(const char* texturePath1, const char* texturePath2);
 
+	Texture(const Texture&) = delete;
+	Texture& operator=(const Texture&) = delete;
+
 
 	void doubleBind();
 	void bind();
 	void unbind();
+	GLuint getId() const { return textureId; }
 private:
 	GLuint textureId;
-	int width, height, nrChannels;
 	GLuint texIDs[2];
 };
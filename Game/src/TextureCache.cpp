@@ -0,0 +1,92 @@
+#include "TextureCache.h"
+
+TextureCache& TextureCache::get()
+{
+	static TextureCache cache;
+	return cache;
+}
+
+GLuint TextureCache::acquire(const string& path, ImageData* image)
+{
+	string key = canonicalPath(path);
+
+	auto found = byPath.find(key);
+	if (found != byPath.end()) {
+		if (image) freeImage(*image);
+		entries[found->second].refCount++;
+		return found->second;
+	}
+
+	ImageData loaded;
+	if (!image || !image->isLoaded()) {
+		size_t slash = path.find_last_of('/');
+		loaded = loadImage(slash == string::npos ? path : path.substr(slash + 1), slash == string::npos ? "." : path.substr(0, slash));
+		image = &loaded;
+	}
+
+	//same pixels under another name, e.g. a texture copied next to every model using it
+	GLuint id;
+	auto sameContent = image->isLoaded() ? byContent.find(image->contentHash) : byContent.end();
+	if (sameContent != byContent.end()) {
+		id = sameContent->second;
+		freeImage(*image);
+		entries[id].refCount++;
+	} else {
+		id = createTexture(*image);
+		entries[id] = { image->contentHash, 1, vector<string>() };
+		if (image->contentHash) byContent[image->contentHash] = id;
+	}
+
+	entries[id].paths.push_back(key);
+	lock_guard<mutex> lock(pathMutex);
+	byPath[key] = id;
+	return id;
+}
+
+void TextureCache::release(GLuint id)
+{
+	auto found = entries.find(id);
+	if (found == entries.end() || --found->second.refCount > 0) return;
+
+	{
+		lock_guard<mutex> lock(pathMutex);
+		for (const string& path : found->second.paths) byPath.erase(path);
+	}
+	if (found->second.contentHash) byContent.erase(found->second.contentHash);
+	entries.erase(found);
+	glDeleteTextures(1, &id);
+}
+
+bool TextureCache::contains(const string& path)
+{
+	string key = canonicalPath(path);
+	lock_guard<mutex> lock(pathMutex);
+	return byPath.count(key) > 0;
+}
+
+string TextureCache::canonicalPath(const string& path)
+{
+	vector<string> segments;
+	string segment;
+	for (size_t i = 0; i <= path.size(); i++) {
+		char c = i < path.size() ? path[i] : '/';
+		if (c == '/' || c == '\\') {
+			if (segment == "..") {
+				if (!segments.empty() && segments.back() != "..") segments.pop_back();
+				else segments.push_back(segment);
+			} else if (!segment.empty() && segment != ".") {
+				segments.push_back(segment);
+			}
+			segment.clear();
+		} else {
+			segment += char(tolower((unsigned char)c));	//file names on Windows are case insensitive
+		}
+	}
+
+	string canonical;
+	for (size_t i = 0; i < segments.size(); i++) {
+		if (i > 0) canonical += '/';
+		canonical += segments[i];
+	}
+	return canonical;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+#include <GL/glew.h>
+#include "Model.h"
+
+using namespace std;
+
+//Process-wide, reference counted cache of GPU textures. Textures are found by canonical
+//file path, and images with identical pixels loaded from different paths share one texture.
+//All of them repeat and filter trilinearly; since every owner sees the same texture object,
+//its parameters must not be changed, other sampling needs a sampler object.
+//Everything but contains() has to be called on the GL thread.
+class TextureCache
+{
+public:
+	static TextureCache& get();
+
+	//returns the texture for a file and adds a reference to it. A decoded image (freed here) is
+	//used when the file isn't cached yet, without one the file is loaded right away.
+	GLuint acquire(const string& path, ImageData* image = nullptr);
+
+	//drops a reference, the texture is deleted with the last one
+	void release(GLuint id);
+
+	//lets loader threads skip decoding files that are already on the GPU
+	bool contains(const string& path);
+
+	//lower case, forward slashes, no "." or ".." segments
+	static string canonicalPath(const string& path);
+
+private:
+	struct Entry {
+		uint64_t contentHash;
+		int refCount;
+		vector<string> paths;		//canonical paths pointing at this texture
+	};
+
+	unordered_map<GLuint, Entry> entries;
+	unordered_map<string, GLuint> byPath;
+	unordered_map<uint64_t, GLuint> byContent;
+	mutex pathMutex;				//guards byPath for contains()
+
+	TextureCache() {}
+	TextureCache(const TextureCache&) = delete;
+	TextureCache& operator=(const TextureCache&) = delete;
+};
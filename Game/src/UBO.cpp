@@ -0,0 +1,31 @@
+#include "UBO.h"
+
+UBO::UBO(GLuint size, GLuint bindingPoint)
+	: bindingPoint(bindingPoint)
+{
+	glGenBuffers(1, &uboId);
+	glBindBuffer(GL_UNIFORM_BUFFER, uboId);
+	glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+	glBindBufferBase(GL_UNIFORM_BUFFER, bindingPoint, uboId);
+}
+
+UBO::~UBO()
+{
+	glDeleteBuffers(1, &uboId);
+}
+
+void UBO::update(const void* data, GLuint size, GLuint offset)
+{
+	glBindBuffer(GL_UNIFORM_BUFFER, uboId);
+	glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+}
+
+void UBO::bind() const
+{
+	glBindBufferBase(GL_UNIFORM_BUFFER, bindingPoint, uboId);
+}
+
+void UBO::unbind() const
+{
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include "GL/glew.h"
+#include "GLFW/glfw3.h"
+
+
+//Uniform buffer object, attached to a binding point shared by all shader programs
+class UBO
+{
+public:
+	UBO(GLuint size, GLuint bindingPoint);
+	~UBO();
+
+	void update(const void* data, GLuint size, GLuint offset = 0);
+
+	void bind() const;
+	void unbind() const;
+
+private:
+	GLuint uboId;
+	GLuint bindingPoint;
+};
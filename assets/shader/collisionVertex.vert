@@ -3,8 +3,11 @@
 layout (location = 0) in vec3 aPos;
 
 uniform mat4 modelMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projectionMatrix;
+layout (std140, binding = 0) uniform Camera {
+	mat4 viewMatrix;
+	mat4 projectionMatrix;
+	vec3 viewPos;
+};
 
 
 void main(){
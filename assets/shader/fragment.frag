@@ -1,53 +1,89 @@
 #version 450
 
+//variant defines, injected by ShaderVariants after the #version line:
+//NR_DIR_LIGHTS					directional light count, matches Light.h
+//SHADOW_CASCADES					shadow cascade count, matches ShadowCascades.h
+//DIFFUSE_MAP						diffuse color from diffuseMap instead of material.color
+//SPECULAR_MAP						specular color from specularMap instead of material.specular
+
 //---------------------INPUT--------------------
 struct Material {
-    sampler2D diffuse;
-	//sampler2D specular;
+    vec3 color;
     vec3 specular;
     float shininess;
 }; 
 uniform Material material;
 
-#define NR_DIR_LIGHTS 3
+#ifdef DIFFUSE_MAP
+layout (binding = 0) uniform sampler2D diffuseMap;
+#endif
+#ifdef SPECULAR_MAP
+layout (binding = 1) uniform sampler2D specularMap;
+#endif
+
 struct DirLight {
 	vec3 direction;
     vec3 ambient;
     vec3 diffuse;
     vec3 specular;
 };
-uniform DirLight dirLights[NR_DIR_LIGHTS];  
 
 
-#define NR_POINT_LIGHTS 2
 struct PointLight {
 	vec3 position;
+	float constant;
     vec3 ambient;
+	float linear;
     vec3 diffuse;
+	float quadratic;
     vec3 specular;
+};
 
-	float constant;
-	float linear;
-	float quadratic;
+//shared by all programs, updated once per frame (see Light.h)
+layout (std140, binding = 0) uniform Camera {
+	mat4 viewMatrix;
+	mat4 projectionMatrix;
+	vec3 viewPos;
+};
+
+layout (std140, binding = 1) uniform Lights {
+	DirLight dirLights[NR_DIR_LIGHTS];
+};
+
+//cascaded shadow maps of dirLights[0] (see ShadowCascades.h)
+layout (std140, binding = 2) uniform Shadows {
+	mat4 lightMatrices[SHADOW_CASCADES];
+	vec4 cascadeSplits;		//view depth where each cascade ends
+};
+layout (binding = 4) uniform sampler2DArrayShadow shadowMap;
+
+//point lights of this frame and the froxel clusters they reach (see LightClusters.h)
+layout (std430, binding = 2) readonly buffer PointLights {
+	PointLight pointLights[];
+};
+
+layout (std430, binding = 3) readonly buffer LightClusters {
+	vec2 tileScale;			//clusters per pixel
+	float sliceScale;		//slice = log(view depth) * sliceScale + sliceBias
+	float sliceBias;
+	uvec4 clusterGrid;
+	uint lightGrid[];		//(offset, count) per cluster, then the light indices
 };
-uniform PointLight pointLights[NR_POINT_LIGHTS];  
 
 
 in vec2 textureCoord;
 in vec3 normal;
 in vec3 fragPos;
 
-uniform sampler2D ourTexture;
-uniform vec3 viewPos;
-
 
 //---------------------OUTPUT--------------------
 out vec4 fragColor;
 
 
 //---------------------prototypes--------------------
-vec3 calcDirLight(DirLight light, vec3 normal, vec3 viewDir);
-vec3 calcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+vec3 calcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec3 albedo, vec3 specularColor, float shadow);
+float calcShadow(vec3 fragPos, float viewDepth);
+vec3 calcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 albedo, vec3 specularColor);
 
 
 void main() {
@@ -56,56 +92,77 @@ void main() {
 	vec3 norm = normalize(normal);
 	vec3 viewDir = normalize(viewPos - fragPos);
 
+	//material colors are sampled once instead of per light
+#ifdef DIFFUSE_MAP
+	vec3 albedo = texture(diffuseMap, textureCoord).rgb;
+#else
+	vec3 albedo = material.color;
+#endif
+#ifdef SPECULAR_MAP
+	vec3 specularColor = texture(specularMap, textureCoord).rgb;
+#else
+	vec3 specularColor = material.specular;
+#endif
+
 	vec3 result = vec3(0.0f);
+	float viewDepth = -(viewMatrix * vec4(fragPos, 1.0)).z;
 
-	//calculate lightings
+	//calculate lightings, the counts are compile time constants so the loops unroll
+	//only the first directional light casts shadows
 	for(int i = 0; i < NR_DIR_LIGHTS; i++){
-		result += calcDirLight(dirLights[i], norm, viewDir);
+		result += calcDirLight(dirLights[i], norm, viewDir, albedo, specularColor, i == 0 ? calcShadow(fragPos, viewDepth) : 1.0);
 	}
 
-	for(int i = 0; i < NR_POINT_LIGHTS; i++){
-		result += calcPointLight(pointLights[i], norm, fragPos, viewDir);
+	//only the point lights that reach this fragment's cluster
+	uvec3 cluster = uvec3(uvec2(gl_FragCoord.xy * tileScale),
+		uint(clamp(log(viewDepth) * sliceScale + sliceBias, 0.0, float(clusterGrid.z - 1))));
+	cluster.xy = min(cluster.xy, clusterGrid.xy - 1);
+	uint index = cluster.x + clusterGrid.x * (cluster.y + clusterGrid.y * cluster.z);
+	uint offset = lightGrid[2 * index];
+	uint count = lightGrid[2 * index + 1];
+	for(uint i = 0; i < count; i++){
+		result += calcPointLight(pointLights[lightGrid[offset + i]], norm, fragPos, viewDir, albedo, specularColor);
 	}
 	
 	fragColor = vec4(result, 1.0f); 
 }
 
-vec3 calcDirLight(DirLight light, vec3 normal, vec3 viewDir){
+vec3 calcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec3 albedo, vec3 specularColor, float shadow){
 	
 	vec3 lightDir = normalize(-light.direction); //position of object irrelevant for directional lights
 
 	//diffuse
 	float diff = max(dot(normal, lightDir), 0.0);
-	vec3 diffuse = light.diffuse * diff * texture(material.diffuse, textureCoord).rgb;
+	vec3 diffuse = light.diffuse * diff * albedo;
 
 	//specular
 	vec3 reflectDir = reflect(-lightDir, normal);
 	float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-	vec3 specular = (material.specular * spec) * light.specular;  
+	vec3 specular = (specularColor * spec) * light.specular;  
 	
 	//ambient
-	vec3 ambient = light.ambient * texture(material.diffuse, textureCoord).rgb;
+	vec3 ambient = light.ambient * albedo;
 	
-	return (ambient + diffuse + specular);
+	return (ambient + shadow * (diffuse + specular));
 	
 }
 
 
-vec3 calcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir){
+vec3 calcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 albedo, vec3 specularColor){
 	
 	vec3 lightDir = normalize(light.position - fragPos); 
 
 	//diffuse
 	float diff = max(dot(normal, lightDir), 0.0);
-	vec3 diffuse = light.diffuse * diff * texture(material.diffuse, textureCoord).rgb;
+	vec3 diffuse = light.diffuse * diff * albedo;
 
 	//specular
 	vec3 reflectDir = reflect(-lightDir, normal);
 	float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-	vec3 specular = light.specular * spec * material.specular; 
+	vec3 specular = light.specular * spec * specularColor; 
 	
 	//ambient
-	vec3 ambient = light.ambient * texture(material.diffuse, textureCoord).rgb;
+	vec3 ambient = light.ambient * albedo;
 
 	//attenuation
 	float distance = length(light.position - fragPos);
@@ -118,3 +175,19 @@ vec3 calcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir){
 	
 	return (ambient + diffuse + specular);
 }
+
+//1 = lit, 0 = in shadow; four hardware filtered lookups, 4x4 texels in total
+float calcShadow(vec3 fragPos, float viewDepth){
+	if (viewDepth >= cascadeSplits[SHADOW_CASCADES - 1]) return 1.0;
+	int cascade = 0;
+	while (cascade < SHADOW_CASCADES - 1 && viewDepth >= cascadeSplits[cascade]) cascade++;
+
+	vec4 lightPos = lightMatrices[cascade] * vec4(fragPos, 1.0);
+	vec3 coord = lightPos.xyz / lightPos.w * 0.5 + 0.5;
+	vec2 texel = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+	float lit = 0.0;
+	for (int x = -1; x <= 1; x += 2)
+		for (int y = -1; y <= 1; y += 2)
+			lit += texture(shadowMap, vec4(coord.xy + vec2(x, y) * texel, cascade, coord.z));
+	return lit * 0.25;
+}
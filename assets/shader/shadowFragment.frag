@@ -0,0 +1,5 @@
+#version 450
+
+//depth only, the shadow framebuffer has no color attachment
+void main() {
+}
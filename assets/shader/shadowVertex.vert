@@ -0,0 +1,19 @@
+#version 450 core
+		
+layout (location = 0) in vec3 aPos;
+layout (location = 3) in uint aDrawIndex;	//per-instance index into DrawData (baseInstance + instance)
+
+struct DrawTransform {
+	mat4 modelMatrix;
+	mat3 normalMatrix;
+};
+layout (std430, binding = 0) readonly buffer DrawData {
+	DrawTransform transforms[];
+};
+
+uniform mat4 lightMatrix;		//world to shadow cascade clip space
+
+
+void main(){
+	gl_Position = lightMatrix * transforms[aDrawIndex].modelMatrix * vec4(aPos, 1.0);
+}
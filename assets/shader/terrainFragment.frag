@@ -3,34 +3,52 @@
 layout(binding=10) uniform sampler2D grass;
 layout(binding=11) uniform sampler2D mountain;
 
+layout (std140, binding = 0) uniform Camera {
+	mat4 viewMatrix;
+	mat4 projectionMatrix;
+	vec3 viewPos;
+};
+
+//cascaded shadow maps of dirLights[0] (see ShadowCascades.h)
+layout (std140, binding = 2) uniform Shadows {
+	mat4 lightMatrices[SHADOW_CASCADES];
+	vec4 cascadeSplits;		//view depth where each cascade ends
+};
+layout (binding = 4) uniform sampler2DArrayShadow shadowMap;
+
 in float height;
 in vec3 Position;
 in vec2 texCoord;
 in vec3 Normal;
+in vec4 splat;		//r grass, g rock, baked into the terrain tiles
 
 out vec4 FragColor;
 
+float calcShadow(vec3 fragPos, float viewDepth);
+
 void main()
 {	
 	vec4 grassColor = texture(grass, texCoord);
 	vec4 mountainColor = texture(mountain, texCoord);
-	//vec3 texColor = mix(grassColor.xyz, mountainColor.xyz, mountainColor.a);
-	//vec3 texColor = vec3(1.0, 0.4, 0.4);
-	if(height >= -30){
-		vec3 texColor = mix(grassColor.xyz, mountainColor.xyz, 0.1);
-		FragColor = vec4(texColor, 1);
-	} 
-
-	else if (height >= -45) {
-		vec3 texColor = mix(grassColor.xyz, mountainColor.xyz, 0.3);
-		FragColor = vec4(texColor, 1);
-	}
-	else if (height >= -60) {
-		vec3 texColor = mix(grassColor.xyz, mountainColor.xyz, 0.6);
-		FragColor = vec4(texColor, 1);
-	}
-	else {
-		vec3 texColor = mix(grassColor.xyz, mountainColor.xyz, 0.9);
-		FragColor = vec4(texColor, 1);
-	}
-}
\ No newline at end of file
+	vec3 texColor = mix(grassColor.xyz, mountainColor.xyz, splat.g / max(splat.r + splat.g, 0.001));
+	//terrain is unlit, shadowed parts are darkened
+	float viewDepth = -(viewMatrix * vec4(Position, 1.0)).z;
+	FragColor = vec4(texColor * mix(0.5, 1.0, calcShadow(Position, viewDepth)), 1);
+}
+
+//1 = lit, 0 = in shadow; four hardware filtered lookups, 4x4 texels in total
+float calcShadow(vec3 fragPos, float viewDepth){
+	if (viewDepth >= cascadeSplits[SHADOW_CASCADES - 1]) return 1.0;
+	int cascade = 0;
+	while (cascade < SHADOW_CASCADES - 1 && viewDepth >= cascadeSplits[cascade]) cascade++;
+
+	vec4 lightPos = lightMatrices[cascade] * vec4(fragPos, 1.0);
+	vec3 coord = lightPos.xyz / lightPos.w * 0.5 + 0.5;
+	vec2 texel = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+	float lit = 0.0;
+	for (int x = -1; x <= 1; x += 2)
+		for (int y = -1; y <= 1; y += 2)
+			lit += texture(shadowMap, vec4(coord.xy + vec2(x, y) * texel, cascade, coord.z));
+	return lit * 0.25;
+}
+
@@ -0,0 +1,52 @@
+#version 450 core
+
+layout (location = 0) in vec2 gridPos;		//0..gridSize, the same grid for every chunk
+
+struct TerrainChunk {
+	vec4 offsetSize;	//corner x, z, size, texture layer of the tile
+	vec4 morph;			//distance where morphing starts and ends, tile corner x, z
+};
+layout (std430, binding = 1) readonly buffer Chunks {
+	TerrainChunk chunks[];
+};
+layout (std140, binding = 0) uniform Camera {
+	mat4 viewMatrix;
+	mat4 projectionMatrix;
+	vec3 viewPos;
+};
+uniform sampler2DArray heightTiles;
+uniform float tileSize;
+uniform float tileSamples;
+uniform float scale;
+uniform float half_scale;
+uniform float gridSize;
+uniform mat4 lightMatrix;		//world to shadow cascade clip space
+
+//texture coordinate of a world position inside the chunk's tile, samples sit on texel centers
+vec3 tileCoord(vec2 xz, TerrainChunk chunk)
+{
+  vec2 uv = (xz - chunk.morph.zw) / tileSize;
+  return vec3((uv*(tileSamples - 1.0) + 0.5) / tileSamples, chunk.offsetSize.w);
+}
+
+float terrainHeight(vec3 coord)
+{
+  return textureLod(heightTiles, coord, 0.0).r*scale - half_scale;
+}
+
+void main()
+{
+  TerrainChunk chunk = chunks[gl_InstanceID];
+  float quadSize = chunk.offsetSize.z / gridSize;
+  vec2 xz = chunk.offsetSize.xy + gridPos*quadSize;
+
+  //geomorphing: odd grid vertices slide onto their even neighbours as the camera moves away,
+  //at the end of the range the chunk is exactly the grid of the next coarser level
+  float distance = length(vec3(xz.x, terrainHeight(tileCoord(xz, chunk)), xz.y) - viewPos);
+  float morphK = clamp((distance - chunk.morph.x) / (chunk.morph.y - chunk.morph.x), 0.0, 1.0);
+  xz -= fract(gridPos*0.5) * 2.0 * morphK * quadSize;
+
+  //same morphed surface as the lit pass, so the terrain doesn't shadow itself
+  float height = terrainHeight(tileCoord(xz, chunk));
+  gl_Position = lightMatrix * vec4(xz.x, height, xz.y, 1.0);
+}
@@ -1,36 +1,65 @@
 #version 450 core
 
-layout(location = 0) in vec3 vVertex;
-layout (location = 1) in vec2 texCoords;
-
-uniform mat4 modelMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projectionMatrix;
-uniform ivec2 HALF_TERRAIN_SIZE;
-uniform sampler2D heightMapTexture;
+layout (location = 0) in vec2 gridPos;		//0..gridSize, the same grid for every chunk
+
+struct TerrainChunk {
+	vec4 offsetSize;	//corner x, z, size, texture layer of the tile
+	vec4 morph;			//distance where morphing starts and ends, tile corner x, z
+};
+layout (std430, binding = 1) readonly buffer Chunks {
+	TerrainChunk chunks[];
+};
+layout (std140, binding = 0) uniform Camera {
+	mat4 viewMatrix;
+	mat4 projectionMatrix;
+	vec3 viewPos;
+};
+uniform sampler2DArray heightTiles;
+uniform sampler2DArray normalTiles;
+uniform sampler2DArray splatTiles;
+uniform float tileSize;
+uniform float tileSamples;
 uniform float scale;
 uniform float half_scale;
+uniform float gridSize;
+uniform float textureTiling;
 
 out float height;
 out vec3 Position;
 out vec2 texCoord;
 out vec3 Normal;
+out vec4 splat;
+
+//texture coordinate of a world position inside the chunk's tile, samples sit on texel centers
+vec3 tileCoord(vec2 xz, TerrainChunk chunk)
+{
+  vec2 uv = (xz - chunk.morph.zw) / tileSize;
+  return vec3((uv*(tileSamples - 1.0) + 0.5) / tileSamples, chunk.offsetSize.w);
+}
+
+float terrainHeight(vec3 coord)
+{
+  return textureLod(heightTiles, coord, 0.0).r*scale - half_scale;
+}
 
 void main()
-{ 
-  vec3 offset = vec3(1.0, 0.0, 1.0);
-  float heightL = texture(heightMapTexture, vVertex.xz - offset.xy).r*scale - half_scale;  // -1, 0
-  float heightR = texture(heightMapTexture, vVertex.xz + offset.xy).r*scale - half_scale;  // +1, 0
-  float heightD = texture(heightMapTexture, vVertex.xz - offset.yz).r*scale - half_scale;  // 0, -1
-  float heightU = texture(heightMapTexture, vVertex.xz + offset.yz).r*scale - half_scale;  // 0, +1
-  Normal.x = heightL - heightR;
-  Normal.z = heightD - heightU;
-  Normal.y = 2.0;
-  Normal = mat3(transpose(inverse(modelMatrix))) * normalize(Normal);
-
-  Position = vec3( modelMatrix * viewMatrix * vec4(vVertex, 1.0) );
-  texCoord = texCoords;
-  height = texture(heightMapTexture, vVertex.xz).r*scale - half_scale;
-  vec2 pos  = (vVertex.xz*2.0-1)*HALF_TERRAIN_SIZE;
-  gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4(pos.x, height, pos.y, 1);
-}
\ No newline at end of file
+{
+  TerrainChunk chunk = chunks[gl_InstanceID];
+  float quadSize = chunk.offsetSize.z / gridSize;
+  vec2 xz = chunk.offsetSize.xy + gridPos*quadSize;
+
+  //geomorphing: odd grid vertices slide onto their even neighbours as the camera moves away,
+  //at the end of the range the chunk is exactly the grid of the next coarser level
+  float distance = length(vec3(xz.x, terrainHeight(tileCoord(xz, chunk)), xz.y) - viewPos);
+  float morphK = clamp((distance - chunk.morph.x) / (chunk.morph.y - chunk.morph.x), 0.0, 1.0);
+  xz -= fract(gridPos*0.5) * 2.0 * morphK * quadSize;
+
+  vec3 coord = tileCoord(xz, chunk);
+  height = terrainHeight(coord);
+  Normal = normalize(textureLod(normalTiles, coord, 0.0).xyz*2.0 - 1.0);
+  splat = textureLod(splatTiles, coord, 0.0);
+
+  Position = vec3(xz.x, height, xz.y);
+  texCoord = xz*textureTiling;
+  gl_Position = projectionMatrix * viewMatrix * vec4(Position, 1.0);
+}
@@ -1,12 +1,15 @@
 #version 450 core
 in vec2 TexCoords;
+in vec4 TextColor;
 out vec4 color;
 
 uniform sampler2D text;
-uniform vec3 textColor;
 
 void main()
 {    
-    vec4 sampled = vec4(1.0, 1.0, 1.0, texture(text, TexCoords).r);
-    color = vec4(textColor, 1.0) * sampled;
-}  
\ No newline at end of file
+    //signed distance field: 0.5 is the outline, smooth over one screen pixel at any scale
+    float distance = texture(text, TexCoords).r;
+    float width = max(fwidth(distance) * 0.5, 0.0001);
+    float alpha = smoothstep(0.5 - width, 0.5 + width, distance);
+    color = vec4(TextColor.rgb, TextColor.a * alpha);
+}
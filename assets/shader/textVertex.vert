@@ -1,11 +1,16 @@
 #version 450 core
-layout (location = 0) in vec4 vertex; // <vec2 pos, vec2 tex>
+layout (location = 0) in vec2 position;		//screen pixels
+layout (location = 1) in vec2 texel;		//glyph atlas texels
+layout (location = 2) in vec4 color;
 out vec2 TexCoords;
+out vec4 TextColor;
 
 uniform mat4 projection;
+uniform sampler2D text;
 
 void main()
 {
-    gl_Position = projection * vec4(vertex.xy, 0.0, 1.0);
-    TexCoords = vertex.zw;
-}  
\ No newline at end of file
+    gl_Position = projection * vec4(position, 0.0, 1.0);
+    TexCoords = texel / vec2(textureSize(text, 0));
+    TextColor = color;
+}
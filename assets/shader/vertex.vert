@@ -3,11 +3,21 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTextureCoord;
+layout (location = 3) in uint aDrawIndex;	//per-instance index into DrawData (baseInstance + instance)
 
 
-uniform mat4 modelMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projectionMatrix;
+struct DrawTransform {
+	mat4 modelMatrix;
+	mat3 normalMatrix;		//inverse transpose of the model matrix, computed on the CPU (see RenderQueue.h)
+};
+layout (std430, binding = 0) readonly buffer DrawData {
+	DrawTransform transforms[];
+};
+layout (std140, binding = 0) uniform Camera {
+	mat4 viewMatrix;
+	mat4 projectionMatrix;
+	vec3 viewPos;
+};
 
 out vec2 textureCoord;	//outputs uv coordinates to the fragment shader
 out vec3 normal;
@@ -15,11 +25,12 @@ out vec3 fragPos;
 
 
 void main(){
+	mat4 model = transforms[aDrawIndex].modelMatrix;
 	
-	fragPos = vec3(modelMatrix * vec4(aPos.x, aPos.y, aPos.z, 1.0));
-	normal = mat3(transpose(inverse(modelMatrix))) * aNormal;
+	fragPos = vec3(model * vec4(aPos.x, aPos.y, aPos.z, 1.0));
+	normal = transforms[aDrawIndex].normalMatrix * aNormal;
 	textureCoord = aTextureCoord;
 	
 
-	gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4(aPos.x, aPos.y, aPos.z, 1.0);
+	gl_Position = projectionMatrix * viewMatrix * model * vec4(aPos.x, aPos.y, aPos.z, 1.0);
 }
\ No newline at end of file
@@ -8,8 +8,11 @@ layout (location = 1) in vec3 normal;
 
 
 uniform mat4 modelMatrix;
-uniform mat4 projectionMatrix;
-uniform mat4 viewMatrix;
+layout (std140, binding = 0) uniform Camera {
+	mat4 viewMatrix;
+	mat4 projectionMatrix;
+	vec3 viewPos;
+};
 //uniform mat3 normalMatrix;
 
 //attribute vec3 position;
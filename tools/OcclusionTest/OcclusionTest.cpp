@@ -0,0 +1,116 @@
+/*
+* Headless check and benchmark of the software occlusion culler, no window or GL context.
+*
+*	OcclusionTest [--frames N]
+*
+* Rasterizes known occluders (a wall of triangles, a box) in front of a fixed camera and
+* checks that boxes hidden behind them are culled while boxes beside, in front of or only
+* partly behind them stay visible, as the culler has to be conservative. Then times frames
+* of a few hundred occluder triangles and a few thousand box tests. Returns 1 on a failed check.
+*/
+#include "OcclusionCuller.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cstdlib>
+
+using namespace std;
+
+static int failures = 0;
+
+static void check(const char* name, bool expected, bool visible)
+{
+	bool passed = visible == expected;
+	if (!passed) failures++;
+	cout << (passed ? "PASS " : "FAIL ") << name << ": " << (visible ? "visible" : "culled") << endl;
+}
+
+static bool isVisible(OcclusionCuller& culler, vec3 minimum, vec3 maximum)
+{
+	return culler.isVisible(mat4(1.0f), minimum, maximum);
+}
+
+//the camera looks down -z from the origin, the wall covers |x|, |y| < 5 at z = -10
+static mat4 viewProjection(const OcclusionSettings& settings)
+{
+	mat4 projection = perspective(radians(60.0f), float(settings.width) / settings.height, 0.1f, 1000.0f);
+	return projection * lookAt(vec3(0.0f), vec3(0.0f, 0.0f, -1.0f), vec3(0.0f, 1.0f, 0.0f));
+}
+
+static void checkOccluder(OcclusionCuller& culler)
+{
+	check("box behind the occluder", false, isVisible(culler, vec3(-1.0f, -1.0f, -21.0f), vec3(1.0f, 1.0f, -20.0f)));
+	check("box beside the occluder", true, isVisible(culler, vec3(15.0f, -0.5f, -21.0f), vec3(16.0f, 0.5f, -20.0f)));
+	check("box in front of the occluder", true, isVisible(culler, vec3(-0.5f, -0.5f, -6.0f), vec3(0.5f, 0.5f, -5.0f)));
+	check("box partly behind the occluder", true, isVisible(culler, vec3(9.0f, -0.5f, -21.0f), vec3(11.0f, 0.5f, -20.0f)));
+	check("box crossing the near plane", true, isVisible(culler, vec3(-0.5f, -0.5f, -1.0f), vec3(0.5f, 0.5f, 1.0f)));
+	check("box behind the camera", false, isVisible(culler, vec3(-0.5f, -0.5f, 5.0f), vec3(0.5f, 0.5f, 6.0f)));
+	check("box outside of the view", false, isVisible(culler, vec3(100.0f, -0.5f, -21.0f), vec3(101.0f, 0.5f, -20.0f)));
+}
+
+static void benchmark(const OcclusionSettings& settings, int frames)
+{
+	//a grid of terrain like quads near the camera and boxes scattered behind them
+	vector<vec3> occluders;
+	for (int z = 0; z < 8; z++) {
+		for (int x = -8; x < 8; x++) {
+			vec3 a(x * 4.0f, -3.0f + 0.2f * (x & 3), -10.0f - z * 4.0f), b = a + vec3(4.0f, 0.0f, 0.0f);
+			vec3 c = a + vec3(0.0f, 1.0f, -4.0f), d = b + vec3(0.0f, 1.0f, -4.0f);
+			occluders.insert(occluders.end(), { a, b, d, a, d, c });
+		}
+	}
+
+	vector<vec3> boxes;
+	srand(1);
+	for (int i = 0; i < 4000; i++)
+		boxes.push_back(vec3(rand() % 200 - 100.0f, rand() % 20 - 6.0f, -float(rand() % 200) - 5.0f));
+
+	OcclusionCuller culler(settings);
+	mat4 vp = viewProjection(settings);
+	size_t culled = 0;
+	auto start = chrono::high_resolution_clock::now();
+	for (int frame = 0; frame < frames; frame++) {
+		culler.begin(vp);
+		culler.addTriangles(occluders);
+		for (const vec3& p : boxes)
+			isVisible(culler, p, p + vec3(1.0f, 2.0f, 1.0f));
+		culled += culler.getCulledCount();
+	}
+	chrono::duration<double, milli> time = chrono::high_resolution_clock::now() - start;
+
+	cout << frames << " frames of " << occluders.size() / 3 << " occluder triangles and " << boxes.size() << " boxes at "
+		<< settings.width << "x" << settings.height << ": " << time.count() / frames << " ms per frame, "
+		<< culled / frames << " boxes culled" << endl;
+}
+
+int main(int argc, char** argv)
+{
+	int frames = 1000;
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if (arg == "--frames" && i + 1 < argc) frames = std::max(atoi(argv[++i]), 1);
+		else cout << "Unknown argument: " << arg << endl;
+	}
+
+	OcclusionSettings settings;
+	OcclusionCuller culler(settings);
+
+	//the wall as two triangles
+	culler.begin(viewProjection(settings));
+	culler.addTriangles({ vec3(-5.0f, -5.0f, -10.0f), vec3(5.0f, -5.0f, -10.0f), vec3(5.0f, 5.0f, -10.0f),
+		vec3(-5.0f, -5.0f, -10.0f), vec3(5.0f, 5.0f, -10.0f), vec3(-5.0f, 5.0f, -10.0f) });
+	checkOccluder(culler);
+
+	//the same wall as the front of a box hull
+	culler.begin(viewProjection(settings));
+	culler.addBox(mat4(1.0f), vec3(-5.0f, -5.0f, -11.0f), vec3(5.0f, 5.0f, -10.0f));
+	checkOccluder(culler);
+
+	benchmark(settings, frames);
+
+	if (failures) cout << failures << " checks failed" << endl;
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,284 @@
+/*
+* Offline converter from JPG/PNG/TGA to block compressed DDS files with a full mip chain.
+*
+*	TextureConverter [--bc1 | --bc3 | --bc5] image...
+*
+* Every image is written next to its source as <name>.dds, where loadImage picks it up in
+* place of the source. Without a format option images with transparent pixels become BC3
+* (DXT5) and all others BC1 (DXT1); --bc5 stores only red and green, for normal maps.
+* Rows are stored bottom-up, matching the flipped stb loads of the game.
+*/
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include "DDSTexture.h"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <climits>
+
+using namespace std;
+
+enum BlockFormat { AUTO, BC1, BC3, BC5 };
+
+struct Image {
+	int width, height;
+	vector<unsigned char> rgba;		//4 channels per pixel
+
+	const unsigned char* pixel(int x, int y) const {
+		x = std::min(x, width - 1);			//blocks on the border repeat the last column/row
+		y = std::min(y, height - 1);
+		return &rgba[(size_t(y) * width + x) * 4];
+	}
+};
+
+
+//------------------------Mip chain------------------------------------
+//2x2 box filter, odd sizes fold the last column/row into the one before
+static Image downsample(const Image& src)
+{
+	Image dst;
+	dst.width = std::max(1, src.width / 2);
+	dst.height = std::max(1, src.height / 2);
+	dst.rgba.resize(size_t(dst.width) * dst.height * 4);
+
+	for (int y = 0; y < dst.height; y++) {
+		for (int x = 0; x < dst.width; x++) {
+			for (int c = 0; c < 4; c++) {
+				int sum = src.pixel(2 * x, 2 * y)[c] + src.pixel(2 * x + 1, 2 * y)[c]
+					+ src.pixel(2 * x, 2 * y + 1)[c] + src.pixel(2 * x + 1, 2 * y + 1)[c];
+				dst.rgba[(size_t(y) * dst.width + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+			}
+		}
+	}
+	return dst;
+}
+
+
+//------------------------Block encoders------------------------------------
+static uint16_t packRGB565(const float color[3])
+{
+	int r = int(std::min(std::max(color[0], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+	int g = int(std::min(std::max(color[1], 0.0f), 255.0f) * 63.0f / 255.0f + 0.5f);
+	int b = int(std::min(std::max(color[2], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+	return uint16_t((r << 11) | (g << 5) | b);
+}
+
+static void unpackRGB565(uint16_t c, int color[3])
+{
+	int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+	color[0] = (r << 3) | (r >> 2);
+	color[1] = (g << 2) | (g >> 4);
+	color[2] = (b << 3) | (b >> 2);
+}
+
+//color endpoints along the principal axis of the block, indices to the nearest of the four palette colors
+static void encodeColorBlock(const unsigned char block[16][4], unsigned char* out)
+{
+	float mean[3] = { 0, 0, 0 };
+	for (int i = 0; i < 16; i++)
+		for (int c = 0; c < 3; c++) mean[c] += block[i][c] / 16.0f;
+
+	float cov[6] = { 0, 0, 0, 0, 0, 0 };	//xx xy xz yy yz zz
+	for (int i = 0; i < 16; i++) {
+		float d[3] = { block[i][0] - mean[0], block[i][1] - mean[1], block[i][2] - mean[2] };
+		cov[0] += d[0] * d[0]; cov[1] += d[0] * d[1]; cov[2] += d[0] * d[2];
+		cov[3] += d[1] * d[1]; cov[4] += d[1] * d[2]; cov[5] += d[2] * d[2];
+	}
+
+	//power iteration for the axis of largest variance
+	float axis[3] = { 1, 1, 1 };
+	for (int it = 0; it < 8; it++) {
+		float v[3] = {
+			cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+			cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+			cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2] };
+		float len = sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+		if (len < 1e-6f) break;
+		for (int c = 0; c < 3; c++) axis[c] = v[c] / len;
+	}
+
+	float minT = 0, maxT = 0;
+	for (int i = 0; i < 16; i++) {
+		float t = (block[i][0] - mean[0]) * axis[0] + (block[i][1] - mean[1]) * axis[1] + (block[i][2] - mean[2]) * axis[2];
+		minT = std::min(minT, t);
+		maxT = std::max(maxT, t);
+	}
+	float e0[3], e1[3];
+	for (int c = 0; c < 3; c++) {
+		e0[c] = mean[c] + axis[c] * maxT;
+		e1[c] = mean[c] + axis[c] * minT;
+	}
+
+	//c0 > c1 selects the four color mode
+	uint16_t c0 = packRGB565(e0), c1 = packRGB565(e1);
+	if (c0 < c1) swap(c0, c1);
+
+	int palette[4][3];
+	unpackRGB565(c0, palette[0]);
+	unpackRGB565(c1, palette[1]);
+	for (int c = 0; c < 3; c++) {
+		palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+		palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+	}
+
+	uint32_t indices = 0;
+	if (c0 != c1) {
+		for (int i = 0; i < 16; i++) {
+			int best = 0, bestError = INT_MAX;
+			for (int p = 0; p < 4; p++) {
+				int dr = block[i][0] - palette[p][0], dg = block[i][1] - palette[p][1], db = block[i][2] - palette[p][2];
+				int error = dr * dr + dg * dg + db * db;
+				if (error < bestError) { bestError = error; best = p; }
+			}
+			indices |= uint32_t(best) << (2 * i);
+		}
+	}
+
+	memcpy(out, &c0, 2);
+	memcpy(out + 2, &c1, 2);
+	memcpy(out + 4, &indices, 4);
+}
+
+//single channel block (BC3 alpha, BC5 red/green) in the eight value mode
+static void encodeChannelBlock(const unsigned char block[16][4], int channel, unsigned char* out)
+{
+	int a0 = 0, a1 = 255;
+	for (int i = 0; i < 16; i++) {
+		a0 = std::max(a0, int(block[i][channel]));
+		a1 = std::min(a1, int(block[i][channel]));
+	}
+
+	uint64_t indices = 0;
+	if (a0 != a1) {
+		int palette[8] = { a0, a1 };
+		for (int p = 1; p < 7; p++) palette[p + 1] = ((7 - p) * a0 + p * a1) / 7;
+
+		for (int i = 0; i < 16; i++) {
+			int best = 0, bestError = INT_MAX;
+			for (int p = 0; p < 8; p++) {
+				int error = abs(block[i][channel] - palette[p]);
+				if (error < bestError) { bestError = error; best = p; }
+			}
+			indices |= uint64_t(best) << (3 * i);
+		}
+	}
+
+	out[0] = (unsigned char)a0;
+	out[1] = (unsigned char)a1;
+	for (int i = 0; i < 6; i++) out[2 + i] = (unsigned char)(indices >> (8 * i));
+}
+
+static vector<unsigned char> compress(const Image& image, BlockFormat format)
+{
+	size_t blockSize = format == BC1 ? 8 : 16;
+	int blocksX = (image.width + 3) / 4, blocksY = (image.height + 3) / 4;
+	vector<unsigned char> out(size_t(blocksX) * blocksY * blockSize);
+
+	unsigned char* dst = out.data();
+	for (int by = 0; by < blocksY; by++) {
+		for (int bx = 0; bx < blocksX; bx++) {
+			unsigned char block[16][4];
+			for (int y = 0; y < 4; y++)
+				for (int x = 0; x < 4; x++)
+					memcpy(block[y * 4 + x], image.pixel(bx * 4 + x, by * 4 + y), 4);
+
+			if (format == BC1) {
+				encodeColorBlock(block, dst);
+			} else if (format == BC3) {
+				encodeChannelBlock(block, 3, dst);
+				encodeColorBlock(block, dst + 8);
+			} else {
+				encodeChannelBlock(block, 0, dst);
+				encodeChannelBlock(block, 1, dst + 8);
+			}
+			dst += blockSize;
+		}
+	}
+	return out;
+}
+
+
+//------------------------DDS output------------------------------------
+static bool convert(const string& path, BlockFormat format)
+{
+	stbi_set_flip_vertically_on_load(true);
+	Image image;
+	int components;
+	unsigned char* pixels = stbi_load(path.c_str(), &image.width, &image.height, &components, 4);
+	if (!pixels) {
+		cout << "ERROR: could not load " << path << endl;
+		return false;
+	}
+	image.rgba.assign(pixels, pixels + size_t(image.width) * image.height * 4);
+	stbi_image_free(pixels);
+
+	if (format == AUTO) {
+		bool transparent = false;
+		for (size_t i = 3; i < image.rgba.size() && !transparent; i += 4) transparent = image.rgba[i] < 255;
+		format = transparent ? BC3 : BC1;
+	}
+
+	int width = image.width, height = image.height;
+	vector<vector<unsigned char>> levels;
+	levels.push_back(compress(image, format));
+	while (image.width > 1 || image.height > 1) {
+		image = downsample(image);
+		levels.push_back(compress(image, format));
+	}
+
+	DDSHeader header;
+	memset(&header, 0, sizeof(header));
+	header.size = sizeof(DDSHeader);
+	header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+	header.width = uint32_t(width);
+	header.height = uint32_t(height);
+	header.pitchOrLinearSize = uint32_t(levels[0].size());
+	header.mipMapCount = uint32_t(levels.size());
+	header.pixelFormat.size = sizeof(DDSPixelFormat);
+	header.pixelFormat.flags = DDPF_FOURCC;
+	header.pixelFormat.fourCC = format == BC1 ? fourCC('D', 'X', 'T', '1') : format == BC3 ? fourCC('D', 'X', 'T', '5') : fourCC('A', 'T', 'I', '2');
+	header.caps = DDSCAPS_TEXTURE | DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+
+	string output = path.substr(0, path.find_last_of('.')) + ".dds";
+	ofstream out(output, ios::binary);
+	if (!out.is_open()) {
+		cout << "ERROR: could not write " << output << endl;
+		return false;
+	}
+	out.write((const char*)&DDS_MAGIC, sizeof(DDS_MAGIC));
+	out.write((const char*)&header, sizeof(header));
+	size_t total = 0;
+	for (const vector<unsigned char>& level : levels) {
+		out.write((const char*)level.data(), level.size());
+		total += level.size();
+	}
+
+	cout << path << " -> " << output << " (" << (format == BC1 ? "BC1" : format == BC3 ? "BC3" : "BC5") << ", "
+		<< levels.size() << " mips, " << total / 1024 << " KB)" << endl;
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	BlockFormat format = AUTO;
+	int failed = 0, converted = 0;
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if (arg == "--bc1") format = BC1;
+		else if (arg == "--bc3") format = BC3;
+		else if (arg == "--bc5") format = BC5;
+		else if (convert(arg, format)) converted++;
+		else failed++;
+	}
+
+	if (converted + failed == 0) {
+		cout << "usage: TextureConverter [--bc1 | --bc3 | --bc5] image..." << endl;
+		return 1;
+	}
+	return failed == 0 ? 0 : 1;
+}